@@ -0,0 +1,773 @@
+/*
+ * User-level stubs for the system calls added by Phase 2. These mirror the ones in libuser: they
+ * may only be called in user mode, and return the result the kernel left in arg4.
+ */
+
+#ifndef _LIBUSER2_H
+#define _LIBUSER2_H
+
+#include <usloss.h>
+#include <usyscall.h>
+#include <libuser.h>
+
+#include "phase2ext.h"
+
+/*
+ * Sys_DiskHeatmap
+ *
+ * Copies up to *tracks per-track access counts of the unit into heat, and sets *tracks to the
+ * size of the disk in tracks.
+ */
+static int
+Sys_DiskHeatmap(int unit, P2_TrackHeat *heat, int *tracks)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (tracks == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_DISKHEATMAP;
+    sa.arg1 = (void *) unit;
+    sa.arg2 = heat;
+    sa.arg3 = (void *) *tracks;
+    USLOSS_Syscall(&sa);
+    *tracks = (int) sa.arg3;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SleepMs
+ *
+ * Sleeps for the specified number of milliseconds.
+ */
+static int
+Sys_SleepMs(int ms)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_SLEEPMS;
+    sa.arg1 = (void *) ms;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SleepUntil
+ *
+ * Sleeps until the specified time, in microseconds as returned by Sys_GetTimeOfDay.
+ */
+static int
+Sys_SleepUntil(int usec)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_SLEEPUNTIL;
+    sa.arg1 = (void *) usec;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_TimerCreate
+ *
+ * Creates a timer that expires every periodMs milliseconds.
+ */
+static int
+Sys_TimerCreate(int periodMs, int *timerId)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (timerId == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_TIMERCREATE;
+    sa.arg1 = (void *) periodMs;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *timerId = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_TimerWait
+ *
+ * Waits for a timer to expire, returns the number of expirations since the last wait.
+ */
+static int
+Sys_TimerWait(int timerId, int *expirations)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (expirations == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_TIMERWAIT;
+    sa.arg1 = (void *) timerId;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *expirations = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_TimerDelete
+ *
+ * Deletes a timer.
+ */
+static int
+Sys_TimerDelete(int timerId)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_TIMERDELETE;
+    sa.arg1 = (void *) timerId;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskReadTimed
+ *
+ * Like Sys_DiskRead, but fails with P2_TIMEOUT if the read hasn't started within timeoutMs
+ * milliseconds.
+ */
+static int
+Sys_DiskReadTimed(void *buffer, int first, int sectors, int unit, int timeoutMs)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_DISKREADTIMED;
+    sa.arg1 = buffer;
+    sa.arg2 = (void *) sectors;
+    sa.arg3 = (void *) first;
+    sa.arg4 = (void *) unit;
+    sa.arg5 = (void *) timeoutMs;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskWriteTimed
+ *
+ * Like Sys_DiskWrite, but fails with P2_TIMEOUT if the write hasn't started within timeoutMs
+ * milliseconds.
+ */
+static int
+Sys_DiskWriteTimed(void *buffer, int first, int sectors, int unit, int timeoutMs)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_DISKWRITETIMED;
+    sa.arg1 = buffer;
+    sa.arg2 = (void *) sectors;
+    sa.arg3 = (void *) first;
+    sa.arg4 = (void *) unit;
+    sa.arg5 = (void *) timeoutMs;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitTimed
+ *
+ * Like Sys_Wait, but fails with P2_TIMEOUT if no child quits within timeoutMs milliseconds.
+ */
+static int
+Sys_WaitTimed(int timeoutMs, int *pid, int *status)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (pid == NULL || status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_WAITTIMED;
+    sa.arg1 = (void *) timeoutMs;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *pid = (int) sa.arg1;
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_ClockStats
+ *
+ * Copies the clock driver's wakeup statistics into info.
+ */
+static int
+Sys_ClockStats(P2_ClockInfo *info)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_CLOCKSTATS;
+    sa.arg1 = info;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_Profile
+ *
+ * Copies the profiler's samples into samples, which must have P1_MAXPROC entries.
+ */
+static int
+Sys_Profile(P2_ProfileSample *samples)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_PROFILE;
+    sa.arg1 = samples;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+static const P2_TimePage *timePage; // mapped by the first Sys_GetTimeCoarse
+
+/*
+ * Sys_GetTimeCoarse
+ *
+ * Returns in *tod the time of the last clock interrupt without trapping into the kernel, except
+ * on the first call, which finds the time page. The result lags Sys_GetTimeOfDay by up to a
+ * clock tick.
+ */
+static void
+Sys_GetTimeCoarse(int *tod)
+{
+    int seq;
+
+    if (timePage == NULL) {
+        USLOSS_Sysargs sa;
+
+        CHECKMODE;
+        sa.number = SYS_TIMEPAGE;
+        USLOSS_Syscall(&sa);
+        timePage = (const P2_TimePage *) sa.arg1;
+    }
+    do {
+        seq = timePage->seq;
+        *tod = timePage->now;
+    } while ((seq & 1) || (seq != timePage->seq));
+}
+
+/*
+ * Sys_GetTime
+ *
+ * Returns the current time in *tod, exactly if precise is TRUE, otherwise as of the last clock
+ * interrupt.
+ */
+static void
+Sys_GetTime(int *tod, int precise)
+{
+    if (precise) {
+        Sys_GetTimeOfDay(tod);
+    } else {
+        Sys_GetTimeCoarse(tod);
+    }
+}
+
+/*
+ * Sys_SyscallStats
+ *
+ * Copies the counters of the specified system call into info.
+ */
+static int
+Sys_SyscallStats(unsigned int number, P2_SyscallInfo *info)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_SYSCALLSTATS;
+    sa.arg1 = (void *) number;
+    sa.arg2 = info;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_Batch
+ *
+ * Makes the count system calls described by calls, in order, with a single trap. Each record
+ * holds the results of its call afterwards, as if it had been passed to USLOSS_Syscall. If
+ * stopOnError is TRUE the batch stops after the first call that returns a negative result.
+ * *done is set to the number of calls made.
+ */
+static int
+Sys_Batch(USLOSS_Sysargs *calls, int count, int stopOnError, int *done)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (done == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_BATCH;
+    sa.arg1 = calls;
+    sa.arg2 = (void *) count;
+    sa.arg3 = (void *) stopOnError;
+    USLOSS_Syscall(&sa);
+    *done = (int) sa.arg1;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_TraceControl
+ *
+ * Turns the system call tracer on or off.
+ */
+static int
+Sys_TraceControl(int on)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_TRACECONTROL;
+    sa.arg1 = (void *) on;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_TraceRead
+ *
+ * Moves up to max of the oldest trace records into records and sets *count to how many.
+ */
+static int
+Sys_TraceRead(P2_TraceRecord *records, int max, int *count)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (count == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_TRACEREAD;
+    sa.arg1 = records;
+    sa.arg2 = (void *) max;
+    USLOSS_Syscall(&sa);
+    *count = (int) sa.arg2;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SpawnMany
+ *
+ * Spawns the count processes described by entries with a single trap and puts their pids in
+ * pids. Stops at the first one that fails. *spawned is set to the number spawned.
+ */
+static int
+Sys_SpawnMany(P2_SpawnEntry *entries, int count, int *pids, int *spawned)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (spawned == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_SPAWNMANY;
+    sa.arg1 = entries;
+    sa.arg2 = (void *) count;
+    sa.arg3 = pids;
+    USLOSS_Syscall(&sa);
+    *spawned = (int) sa.arg1;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitN
+ *
+ * Waits for n children, or all of them if there are fewer, and puts their pids and statuses in
+ * pids and statuses. *count is set to the number waited for.
+ */
+static int
+Sys_WaitN(int n, int *pids, int *statuses, int *count)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (count == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_WAITN;
+    sa.arg1 = (void *) n;
+    sa.arg2 = pids;
+    sa.arg3 = statuses;
+    USLOSS_Syscall(&sa);
+    *count = (int) sa.arg1;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitPid
+ *
+ * Waits for the specified child, which must have been created by Sys_Spawn.
+ */
+static int
+Sys_WaitPid(int pid, int *status)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_WAITPID;
+    sa.arg1 = (void *) pid;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitNoHang
+ *
+ * Returns the child that exited first without waiting. *pid is -1 if none has exited yet.
+ */
+static int
+Sys_WaitNoHang(int *pid, int *status)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if ((pid == NULL) || (status == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_WAITNOHANG;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *pid = (int) sa.arg1;
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_GetProcUsage
+ *
+ * Copies the resources used by the process into usage. A process that has exited can still be
+ * queried until its parent waits for it.
+ */
+static int
+Sys_GetProcUsage(int pid, P2_ProcUsage *usage)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_GETPROCUSAGE;
+    sa.arg1 = (void *) pid;
+    sa.arg2 = usage;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_GetProcSnapshot
+ *
+ * Copies the pid and information of up to max live processes into buffer with a single trap, and
+ * sets *count to how many. If states isn't 0 only processes in the states it selects, made with
+ * P2_STATE, are copied.
+ */
+static int
+Sys_GetProcSnapshot(P2_ProcSnapshot *buffer, int max, int states, int *count)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (count == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_GETPROCSNAPSHOT;
+    sa.arg1 = buffer;
+    sa.arg2 = (void *) max;
+    sa.arg3 = (void *) states;
+    USLOSS_Syscall(&sa);
+    *count = (int) sa.arg2;
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_FutexWait
+ *
+ * Blocks until Sys_FutexWake is called on addr, unless *addr no longer equals expected. Used by
+ * the user-level locks in ulock.h when they are contended.
+ */
+static int
+Sys_FutexWait(int *addr, int expected)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_FUTEXWAIT;
+    sa.arg1 = addr;
+    sa.arg2 = (void *) expected;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_FutexWake
+ *
+ * Wakes up to max processes waiting on addr. *woken is set to the number woken; it may be NULL.
+ */
+static int
+Sys_FutexWake(int *addr, int max, int *woken)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_FUTEXWAKE;
+    sa.arg1 = addr;
+    sa.arg2 = (void *) max;
+    USLOSS_Syscall(&sa);
+    if (woken != NULL) {
+        *woken = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxCreate
+ *
+ * Creates a mailbox that holds up to slots messages and puts its id in *mbox.
+ */
+static int
+Sys_MailboxCreate(int slots, int *mbox)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (mbox == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_MAILBOXCREATE;
+    sa.arg1 = (void *) slots;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *mbox = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxRelease
+ *
+ * Frees an empty mailbox nobody is waiting on.
+ */
+static int
+Sys_MailboxRelease(int mbox)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_MAILBOXRELEASE;
+    sa.arg1 = (void *) mbox;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxSend
+ *
+ * Hands the buffer to the mailbox, waiting while it is full. The buffer isn't copied, so the
+ * caller must not use it afterwards.
+ */
+static int
+Sys_MailboxSend(int mbox, void *buffer, int size)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_MAILBOXSEND;
+    sa.arg1 = (void *) mbox;
+    sa.arg2 = buffer;
+    sa.arg3 = (void *) size;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxReceive
+ *
+ * Receives the oldest message, waiting while the mailbox is empty. The caller now owns *buffer,
+ * which holds *size bytes.
+ */
+static int
+Sys_MailboxReceive(int mbox, void **buffer, int *size)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if ((buffer == NULL) || (size == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_MAILBOXRECEIVE;
+    sa.arg1 = (void *) mbox;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *buffer = sa.arg2;
+        *size = (int) sa.arg3;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxCondSend
+ *
+ * Like Sys_MailboxSend, but returns P2_WOULD_BLOCK instead of waiting.
+ */
+static int
+Sys_MailboxCondSend(int mbox, void *buffer, int size)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    sa.number = SYS_MAILBOXCONDSEND;
+    sa.arg1 = (void *) mbox;
+    sa.arg2 = buffer;
+    sa.arg3 = (void *) size;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MailboxCondReceive
+ *
+ * Like Sys_MailboxReceive, but returns P2_WOULD_BLOCK instead of waiting.
+ */
+static int
+Sys_MailboxCondReceive(int mbox, void **buffer, int *size)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if ((buffer == NULL) || (size == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_MAILBOXCONDRECEIVE;
+    sa.arg1 = (void *) mbox;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *buffer = sa.arg2;
+        *size = (int) sa.arg3;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitEvents
+ *
+ * Waits until at least one of the count events has happened, sets their ready fields and puts the
+ * number that are ready in *ready.
+ */
+static int
+Sys_WaitEvents(P2_Event *events, int count, int *ready)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (ready == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_WAITEVENTS;
+    sa.arg1 = events;
+    sa.arg2 = (void *) count;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *ready = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskReadAsync
+ *
+ * Starts a read and returns without waiting for it. The ticket names the request in a
+ * P2_EVENT_DISK event and in Sys_DiskCollect.
+ */
+static int
+Sys_DiskReadAsync(void *buffer, int first, int sectors, int unit, int *ticket)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (ticket == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_DISKREADASYNC;
+    sa.arg1 = buffer;
+    sa.arg2 = (void *) sectors;
+    sa.arg3 = (void *) first;
+    sa.arg4 = (void *) unit;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *ticket = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskWriteAsync
+ *
+ * Like Sys_DiskReadAsync, but for a write.
+ */
+static int
+Sys_DiskWriteAsync(void *buffer, int first, int sectors, int unit, int *ticket)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (ticket == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_DISKWRITEASYNC;
+    sa.arg1 = buffer;
+    sa.arg2 = (void *) sectors;
+    sa.arg3 = (void *) first;
+    sa.arg4 = (void *) unit;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *ticket = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskCollect
+ *
+ * Puts the result of a finished asynchronous request in *status. Fails with P2_WOULD_BLOCK if it
+ * hasn't finished.
+ */
+static int
+Sys_DiskCollect(int ticket, int *status)
+{
+    USLOSS_Sysargs sa;
+
+    CHECKMODE;
+    if (status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    sa.number = SYS_DISKCOLLECT;
+    sa.arg1 = (void *) ticket;
+    USLOSS_Syscall(&sa);
+    if ((int) sa.arg4 == P1_SUCCESS) {
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * Internal definitions of the Phase 2 extensions, used by the parts of Phase 2 to hook into
+ * each other. phase2Int.h is handed out and must not be modified, so they are declared here.
+ */
+
+#ifndef _PHASE2_EXT_INT_H
+#define _PHASE2_EXT_INT_H
+
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+// Phase 2a
+
+void    P2AddExitHook(void (*hook)(int pid));
+int     P2ProcExiting(int pid);
+int     P2ProcWaitReady(int pid);
+P2_ProcUsage *P2ProcAccount(int pid);
+void    P2AddEventSource(int type, int (*ready)(int id));
+void    P2EventNotify(int type, int id);
+
+// Phase 2b
+
+void    P2TimeoutStart(int ms, void (*expire)(int pid));
+void    P2TimeoutCancel(void);
+
+#endif
@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <usloss.h>
 #include <phase1.h>
 #include <phase2.h>
@@ -8,11 +10,223 @@
 #include <usyscall.h>
 
 #include "phase2Int.h"
+#include "phase2ExtInt.h"
 
 #define TAG_KERNEL 0
 #define TAG_USER 1
 
+#define MAX_EXIT_HOOKS 8
+
+// number of futex wait queues, a power of two
+#define FUTEX_BUCKETS 64
+
 static void SpawnStub(USLOSS_Sysargs *sysargs);
+static void WaitStub(USLOSS_Sysargs *sysargs);
+static void TerminateStub(USLOSS_Sysargs *sysargs);
+static void GetTimeOfDayStub(USLOSS_Sysargs *sysargs);
+static void GetProcInfoStub(USLOSS_Sysargs *sysargs);
+static void GetPidStub(USLOSS_Sysargs *sysargs);
+static void SyscallStatsStub(USLOSS_Sysargs *sysargs);
+static void BatchStub(USLOSS_Sysargs *sysargs);
+static void TraceControlStub(USLOSS_Sysargs *sysargs);
+static void TraceReadStub(USLOSS_Sysargs *sysargs);
+static void SpawnManyStub(USLOSS_Sysargs *sysargs);
+static void WaitNStub(USLOSS_Sysargs *sysargs);
+static void WaitPidStub(USLOSS_Sysargs *sysargs);
+static void WaitNoHangStub(USLOSS_Sysargs *sysargs);
+static void GetProcUsageStub(USLOSS_Sysargs *sysargs);
+static void GetProcSnapshotStub(USLOSS_Sysargs *sysargs);
+static void FutexWaitStub(USLOSS_Sysargs *sysargs);
+static void FutexWakeStub(USLOSS_Sysargs *sysargs);
+static void MboxCreateStub(USLOSS_Sysargs *sysargs);
+static void MboxReleaseStub(USLOSS_Sysargs *sysargs);
+static void MboxSendStub(USLOSS_Sysargs *sysargs);
+static void MboxReceiveStub(USLOSS_Sysargs *sysargs);
+static void MboxCondSendStub(USLOSS_Sysargs *sysargs);
+static void MboxCondReceiveStub(USLOSS_Sysargs *sysargs);
+static void WaitEventsStub(USLOSS_Sysargs *sysargs);
+static int ChildReady(int pid);
+static void Release(int pid);
+static void Verify(int pid);
+static int MboxReceivable(int mbox);
+static int MboxSendable(int mbox);
+
+// a child that has exited and not been waited for
+typedef struct Exit {
+    int     pid;
+    int     status;
+    int     joined;             // TRUE if P1_Join has already returned it
+    struct Exit *next;          // in the parent's queue, or on the free list
+    struct Exit *prev;
+} Exit;
+
+typedef struct Proc {
+    int     spawned;            // TRUE if the process was created by P2_Spawn
+    int     exiting;            // TRUE from P2_Terminate until the process is joined
+    Exit    *exit;              // set while the process waits in P2_Terminate to be reaped
+    int     parent;             // process that spawned it, -1 if none or it has terminated
+    int     live;               // spawned children that haven't called P2_Terminate
+    Exit    *head;              // children that have exited, in exit order
+    Exit    *tail;
+    int     exits;              // length of the queue
+    int     waitingFor;         // exits a wait is waiting for, 0 if it isn't waiting
+    int     waitingPid;         // child P2_WaitPid is waiting for, -1 if it isn't
+    int     *futex;             // address the process is waiting on in P2_FutexWait, or NULL
+    int     nextFutex;          // next process in the same futex queue, or -1
+    P2_Event *events;           // events the process waits for in P2_WaitEvents
+    int     numEvents;          // 0 if it isn't in P2_WaitEvents
+    int     notified;           // TRUE once one of those events may have happened
+    int     nextWaiter[P2_EVENT_TYPES]; // next process waiting for each event type, or -1
+    int     cond;               // waits for children, for being reaped, on futexes and for events
+    uintptr_t stackTop;         // Launch's frame, where stack use is measured from
+    unsigned int *stackLow;     // lowest painted word of the stack, NULL if it isn't painted
+    int     stackSize;          // size of the painted stack
+    int     stackUsed;          // bytes used, measured when the function returns, or -1
+    int     stackStats;         // index in stackStats of the process's name
+    P2_ProcUsage usage;         // userTime is only filled in by P2_GetProcUsage
+    int     calls;              // system calls the process is in, more than 1 inside P2_Batch
+} Proc;
+
+// a message is a reference to the sender's buffer, which then belongs to the receiver
+typedef struct Message {
+    void    *buffer;
+    int     size;
+} Message;
+
+typedef struct Mbox {
+    int     inUse;
+    int     slots;              // capacity
+    int     count;              // messages in the mailbox
+    int     head;               // slot of the oldest message
+    Message messages[P2_MAX_SLOTS];
+    int     senders;            // processes waiting for a free slot
+    int     receivers;          // processes waiting for a message
+    int     notFull;
+    int     notEmpty;
+} Mbox;
+
+// passed to Launch, which returns it to the free list
+typedef struct Start {
+    int     (*func)(void *);
+    void    *arg;
+    int     stackSize;
+    int     stackStats;         // index in stackStats, -1 if the stack isn't to be painted
+    int     parent;             // process calling P2_Spawn
+    struct Start *next;
+} Start;
+
+static int procLock;            // protects the exit queues and the counts that go with them
+
+#define LOCK() { \
+    int _rc = P1_Lock(procLock); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+#define UNLOCK() { \
+    int _rc = P1_Unlock(procLock); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+#define MBOX_LOCK() { \
+    int _rc = P1_Lock(mboxLock); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+#define MBOX_UNLOCK() { \
+    int _rc = P1_Unlock(mboxLock); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+static Proc procs[P1_MAXPROC];
+
+// Spawned processes that have exited are queued on their parent until it waits for them. Each
+// spawned process can have a record, and so can a child not created by P2_Spawn that P1_Join
+// returned while a spawned one was being reaped.
+static Exit exitRecs[2 * P1_MAXPROC];
+static Exit *freeExits;
+
+static Mbox mboxes[P2_MAX_MBOXES];
+static int mboxLock;            // protects mboxes
+
+// Processes in P2_FutexWait, in one queue per hash of the address, in the order they arrived.
+// Protected by procLock.
+static int futexes[FUTEX_BUCKETS];
+
+// Every process that hasn't launched yet holds one Start, and so does every process in the
+// middle of P2_Spawn, so P1_MAXPROC of them are enough.
+static Start starts[P1_MAXPROC];
+static Start *freeStarts;
+
+// Stack sizes up to stackCap are rounded up to a size class, a power-of-two multiple of
+// USLOSS_MIN_STACK. The stacks Phase 1 frees when processes are joined are then the sizes later
+// spawns ask for, and the allocator may hand them straight back from its free lists. Phase 1
+// allocates and frees the stacks itself, so Phase 2 can't keep free lists of its own. Measured
+// against glibc malloc, classes made spawning one process at a time no faster while asking for
+// 80% more memory, and with 40 processes live cut malloc from 0.34 to 0.19 us while asking for
+// 33% more; both are small next to creating a context. So stackCap is 0, i.e. no rounding, until
+// P2_SpawnSetStackCap sets it.
+static int stackCap;
+
+// Stack measurement. Outside P2_STACK_FIXED mode Launch fills part of the new stack below its own
+// frame with STACK_PAINT and, when the process's function returns, looks for the lowest word that
+// has been overwritten. Stacks grow down. P1_Fork allocates exactly the stack size asked for, and
+// USLOSS starts the process at the top of it, so above Launch's frame there are only the frames
+// of the USLOSS and Phase 1 start routines. Phase 1 doesn't say where the stack begins, so the
+// stack is painted from STACK_RESERVE bytes above where it would begin if Launch's frame were at
+// the top, which stays inside the stack as long as those start routines take less than
+// STACK_RESERVE. They are a few small frames, so at most STACK_RESERVE bytes at the bottom are left
+// unpainted. The STACK_GAP bytes below Launch's frame are the ones Launch is using while it paints
+// and are not painted either. A process that overwrites the lowest painted word is taken to have
+// used its whole stack. stackStats is protected by procLock.
+#define STACK_PAINT     0xA5A5A5A5
+#define STACK_GAP       1024
+#define STACK_RESERVE   2048
+
+static int stackMode;
+static P2_StackStats stackStats[P2_STACK_NAMES];
+static int numStackStats;
+
+// Readiness tests of the event types, see P2AddEventSource. Processes in P2_WaitEvents poll
+// them, and sleep until the owner of a source calls P2EventNotify for one of their events.
+// eventWaiters[type] is the first process in P2_WaitEvents waiting for an event of the type, or
+// -1, and the rest follow through nextWaiter[type]. Protected by procLock.
+static int (*eventSources[P2_EVENT_TYPES])(int id);
+static int eventWaiters[P2_EVENT_TYPES];
+
+static void (*exitHooks[MAX_EXIT_HOOKS])(int pid);
+static int numExitHooks = 0;
+
+// system call table, indexed by system call number
+static void (*handlers[P2_MAX_SYSCALLS])(USLOSS_Sysargs *args);
+static P2_SyscallInfo syscallInfo[P2_MAX_SYSCALLS];
+
+/*
+ * System call tracer. While tracing is on, Dispatch writes a record for each system call into
+ * a ring buffer when the call returns, so a Sys_Terminate is never traced. traced counts the
+ * records written; the oldest record that hasn't been read has sequence number traceRead. When
+ * tracing is off the only cost is the test of tracing in Dispatch.
+ */
+
+static int tracing = FALSE;
+static P2_TraceRecord trace[P2_TRACE_RECORDS];
+static int traced;
+static int traceRead;
+
+/*
+ * CurrentTime
+ *
+ * Returns the current time in microseconds.
+ *
+ */
+
+static int
+CurrentTime(void)
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
 
 /*
  * IllegalHandler
@@ -24,7 +238,118 @@ static void SpawnStub(USLOSS_Sysargs *sysargs);
 static void 
 IllegalHandler(int type, void *arg) 
 {
-    // do something here
+    int rc = P2_Terminate(2048);
+    // kernel processes aren't spawned, so P2_Terminate won't quit them
+    assert(rc == P2_NOT_SPAWNED);
+    P1_Quit(2048);
+}
+
+/*
+ * Call
+ *
+ * Calls the handler for a valid system call, updates its counters and returns the times of
+ * entry and exit. Only the outermost call of a process is charged to its usage, so the calls
+ * P2_Batch makes are counted once, as part of the batch. Phase 1 only reports CPU time through
+ * a copy of the whole P1_ProcInfo, so the handler's kernel time is instead its elapsed time less
+ * the time it spent asleep or waiting for the disk, which the drivers already measure; the
+ * clock is read only at entry and exit. Time blocked elsewhere, e.g. in P2_Wait, is charged as
+ * kernel time, and P2_GetProcUsage clips userTime at zero. The counters are shared by all
+ * processes, so interrupts are disabled while they are updated.
+ *
+ */
+
+static void 
+Call(USLOSS_Sysargs *sysargs, int *start, int *end)
+{
+    P2_SyscallInfo *info = &syscallInfo[sysargs->number];
+    int pid = P1_GetPid();
+    Proc *self = &procs[pid];
+    int outer = (self->calls++ == 0);
+    unsigned int psr = USLOSS_PsrGet();
+    int blocked = 0;
+    int elapsed;
+
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    info->calls++;
+    USLOSS_PsrSet(psr);
+    if (outer) {
+        self->usage.syscalls++;
+        blocked = self->usage.sleepTime + self->usage.diskTime;
+    }
+    *start = CurrentTime();
+    handlers[sysargs->number](sysargs);
+    *end = CurrentTime();
+    self->calls--;
+    elapsed = *end - *start;
+    if (outer) {
+        blocked = self->usage.sleepTime + self->usage.diskTime - blocked;
+        if (elapsed > blocked) {
+            self->usage.kernelTime += elapsed - blocked;
+        }
+    }
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    if ((int) sysargs->arg4 < 0) {
+        info->errors++;
+    }
+    info->time += elapsed;
+    if (elapsed > info->maxTime) {
+        info->maxTime = elapsed;
+    }
+    USLOSS_PsrSet(psr);
+}
+
+/*
+ * TracedCall
+ *
+ * Calls the handler for a valid system call and records the call in the trace. The ring is
+ * shared by all processes, so interrupts are disabled while the record is added.
+ *
+ */
+
+static void 
+TracedCall(USLOSS_Sysargs *sysargs)
+{
+    P2_TraceRecord record;
+    unsigned int psr = USLOSS_PsrGet();
+
+    record.pid = P1_GetPid();
+    record.number = sysargs->number;
+    record.args[0] = (int) sysargs->arg1;
+    record.args[1] = (int) sysargs->arg2;
+    record.args[2] = (int) sysargs->arg3;
+    Call(sysargs, &record.entry, &record.exit);
+    record.rc = (int) sysargs->arg4;
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    record.seq = traced;
+    trace[traced % P2_TRACE_RECORDS] = record;
+    traced++;
+    USLOSS_PsrSet(psr);
+}
+
+/*
+ * Dispatch
+ *
+ * Calls the handler for a system call.
+ *
+ */
+
+static void 
+Dispatch(USLOSS_Sysargs *sysargs)
+{
+    unsigned int number = sysargs->number;
+    int start;
+    int end;
+
+    if ((number >= P2_MAX_SYSCALLS) || (handlers[number] == NULL)) {
+        sysargs->arg4 = (void *) P2_INVALID_SYSCALL;
+        return;
+    }
+    // call the proper handler for the system call.
+    if (tracing) {
+        TracedCall(sysargs);
+    } else {
+        Call(sysargs, &start, &end);
+    }
 }
 
 /*
@@ -37,9 +362,8 @@ IllegalHandler(int type, void *arg)
 static void 
 SyscallHandler(int type, void *arg) 
 {
-    USLOSS_Sysargs *sysargs = (USLOSS_Sysargs *) arg;
-    // call the proper handler for the system call.
-    sysargs->arg4 = (void *) P2_INVALID_SYSCALL;
+    assert(type == USLOSS_SYSCALL_INT);
+    Dispatch((USLOSS_Sysargs *) arg);
 }
 
 
@@ -50,17 +374,140 @@ SyscallHandler(int type, void *arg)
  *
  */
 
-void
+void 
 P2ProcInit(void) 
 {
     int rc;
 
+    rc = P1_LockCreate("Proc Lock", &procLock);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        char name[P1_MAXNAME+1];
+
+        procs[i].spawned = FALSE;
+        procs[i].exiting = FALSE;
+        procs[i].exit = NULL;
+        procs[i].parent = -1;
+        procs[i].live = 0;
+        procs[i].head = NULL;
+        procs[i].tail = NULL;
+        procs[i].exits = 0;
+        procs[i].waitingFor = 0;
+        procs[i].waitingPid = -1;
+        procs[i].futex = NULL;
+        procs[i].nextFutex = -1;
+        procs[i].events = NULL;
+        procs[i].numEvents = 0;
+        for (int j = 0; j < P2_EVENT_TYPES; j++) {
+            procs[i].nextWaiter[j] = -1;
+        }
+        procs[i].stackLow = NULL;
+        procs[i].stackUsed = -1;
+        memset(&procs[i].usage, 0, sizeof(procs[i].usage));
+        procs[i].calls = 0;
+        snprintf(name, sizeof(name), "Exits %d", i);
+        rc = P1_CondCreate(name, procLock, &procs[i].cond);
+        assert(rc == P1_SUCCESS);
+    }
+    for (int i = 0; i < FUTEX_BUCKETS; i++) {
+        futexes[i] = -1;
+    }
+    rc = P1_LockCreate("Mbox Lock", &mboxLock);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < P2_MAX_MBOXES; i++) {
+        char name[P1_MAXNAME+1];
+
+        mboxes[i].inUse = FALSE;
+        snprintf(name, sizeof(name), "Mbox %d not full", i);
+        rc = P1_CondCreate(name, mboxLock, &mboxes[i].notFull);
+        assert(rc == P1_SUCCESS);
+        snprintf(name, sizeof(name), "Mbox %d not empty", i);
+        rc = P1_CondCreate(name, mboxLock, &mboxes[i].notEmpty);
+        assert(rc == P1_SUCCESS);
+    }
+    freeExits = NULL;
+    for (int i = 0; i < 2 * P1_MAXPROC; i++) {
+        exitRecs[i].next = freeExits;
+        freeExits = &exitRecs[i];
+    }
+    freeStarts = NULL;
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        starts[i].next = freeStarts;
+        freeStarts = &starts[i];
+    }
+    stackCap = 0;
+    stackMode = P2_STACK_FIXED;
+    numStackStats = 0;
+    for (int i = 0; i < P2_EVENT_TYPES; i++) {
+        eventSources[i] = NULL;
+        eventWaiters[i] = -1;
+    }
+    P2AddEventSource(P2_EVENT_CHILD, ChildReady);
+    P2AddEventSource(P2_EVENT_MBOX_RECV, MboxReceivable);
+    P2AddEventSource(P2_EVENT_MBOX_SEND, MboxSendable);
+    numExitHooks = 0;
+    for (int i = 0; i < P2_MAX_SYSCALLS; i++) {
+        handlers[i] = NULL;
+    }
+    memset(syscallInfo, 0, sizeof(syscallInfo));
+    tracing = FALSE;
+    traced = 0;
+    traceRead = 0;
+
     USLOSS_IntVec[USLOSS_ILLEGAL_INT] = IllegalHandler;
     USLOSS_IntVec[USLOSS_SYSCALL_INT] = SyscallHandler;
 
     // call P2_SetSyscallHandler to set handlers for all system calls
     rc = P2_SetSyscallHandler(SYS_SPAWN, SpawnStub);
     assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TERMINATE, TerminateStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAIT, WaitStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_GETTIMEOFDAY, GetTimeOfDayStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_GETPROCINFO, GetProcInfoStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_GETPID, GetPidStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SYSCALLSTATS, SyscallStatsStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_BATCH, BatchStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TRACECONTROL, TraceControlStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TRACEREAD, TraceReadStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SPAWNMANY, SpawnManyStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITN, WaitNStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITPID, WaitPidStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITNOHANG, WaitNoHangStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_GETPROCUSAGE, GetProcUsageStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_GETPROCSNAPSHOT, GetProcSnapshotStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_FUTEXWAIT, FutexWaitStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_FUTEXWAKE, FutexWakeStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXCREATE, MboxCreateStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXRELEASE, MboxReleaseStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXSEND, MboxSendStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXRECEIVE, MboxReceiveStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXCONDSEND, MboxCondSendStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MAILBOXCONDRECEIVE, MboxCondReceiveStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITEVENTS, WaitEventsStub);
+    assert(rc == P1_SUCCESS);
 }
 
 /*
@@ -70,73 +517,2002 @@ P2ProcInit(void)
  *
  */
 
-int
+int 
 P2_SetSyscallHandler(unsigned int number, void (*handler)(USLOSS_Sysargs *args))
 {
+    if (!(USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE)) {
+        USLOSS_IllegalInstruction();
+    }
+    if ((number == 0) || (number >= P2_MAX_SYSCALLS)) {
+        return P2_INVALID_SYSCALL;
+    }
+    handlers[number] = handler;
     return P1_SUCCESS;
 }
 
 /*
- * P2_Spawn
+ * P2_SyscallStats
  *
- * Spawn a user-level process.
+ * Copies the counters of the specified system call into info.
  *
  */
+
 int 
-P2_Spawn(char *name, int(*func)(void *arg), void *arg, int stackSize, int priority, int *pid) 
+P2_SyscallStats(unsigned int number, P2_SyscallInfo *info)
 {
-    // do something here
+    unsigned int psr = USLOSS_PsrGet();
+
+    if ((number == 0) || (number >= P2_MAX_SYSCALLS)) {
+        return P2_INVALID_SYSCALL;
+    }
+    if (info == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    // a consistent copy
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    *info = syscallInfo[number];
+    USLOSS_PsrSet(psr);
     return P1_SUCCESS;
 }
 
 /*
- * P2_Wait
+ * P2_Batch
  *
- * Wait for a user-level process.
+ * Makes count system calls in order, as if each record had been passed to the system call
+ * handler. If stopOnError is TRUE it stops after the first call that leaves a negative result
+ * in arg4. Sets *done to the number of calls made. Batches can't be nested.
  *
  */
 
 int 
-P2_Wait(int *pid, int *status) 
+P2_Batch(USLOSS_Sysargs *calls, int count, int stopOnError, int *done)
+{
+    if ((calls == NULL) || (done == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (count < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    for (*done = 0; *done < count; (*done)++) {
+        USLOSS_Sysargs *call = &calls[*done];
+        if (call->number == SYS_BATCH) {
+            call->arg4 = (void *) P2_INVALID_SYSCALL;
+        } else {
+            Dispatch(call);
+        }
+        if (stopOnError && ((int) call->arg4 < 0)) {
+            (*done)++;
+            break;
+        }
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_TraceControl
+ *
+ * Turns the system call tracer on or off.
+ *
+ */
+
+int 
+P2_TraceControl(int on)
 {
-    // do something here
+    tracing = on ? TRUE : FALSE;
     return P1_SUCCESS;
 }
 
 /*
- * P2_Terminate
+ * P2_TraceRead
  *
- * Terminate a user-level process.
+ * Moves up to max of the oldest trace records into records, and sets *count to the number
+ * moved. Records that were overwritten before being read are skipped.
  *
  */
 
 int 
-P2_Terminate(int status) 
+P2_TraceRead(P2_TraceRecord *records, int max, int *count)
 {
-    // do something here
+    unsigned int psr = USLOSS_PsrGet();
+
+    if ((records == NULL) || (count == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (max < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    if (traceRead < traced - P2_TRACE_RECORDS) {
+        traceRead = traced - P2_TRACE_RECORDS;
+    }
+    for (*count = 0; (*count < max) && (traceRead < traced); (*count)++) {
+        records[*count] = trace[traceRead % P2_TRACE_RECORDS];
+        traceRead++;
+    }
+    USLOSS_PsrSet(psr);
     return P1_SUCCESS;
+}
+
+/*
+ * P2AddExitHook
+ *
+ * Registers a function that P2_Terminate calls with the pid of the terminating process, so that
+ * other parts of Phase 2 can release what the process still holds.
+ *
+ */
 
+void 
+P2AddExitHook(void (*hook)(int pid))
+{
+    assert(numExitHooks < MAX_EXIT_HOOKS);
+    exitHooks[numExitHooks++] = hook;
 }
 
 /*
- * SpawnStub
+ * StartAlloc
  *
- * Stub for Sys_Spawn system call. 
+ * Takes a Start off the free list, or returns NULL if there isn't one.
+ *
+ */
+
+static Start *
+StartAlloc(void)
+{
+    unsigned int psr = USLOSS_PsrGet();
+    Start *start;
+
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    start = freeStarts;
+    if (start != NULL) {
+        freeStarts = start->next;
+    }
+    USLOSS_PsrSet(psr);
+    return start;
+}
+
+/*
+ * StartFree
+ *
+ * Puts a Start back on the free list.
  *
  */
 
 static void 
-SpawnStub(USLOSS_Sysargs *sysargs) 
+StartFree(Start *start)
 {
-    int (*func)(void *) = sysargs->arg1;
-    void *arg = sysargs->arg2;
-    int stackSize = (int) sysargs->arg3;
-    int priority = (int) sysargs->arg4;
-    char *name = sysargs->arg5;
-    int pid;
-    int rc = P2_Spawn(name, func, arg, stackSize, priority, &pid);
-    if (rc == P1_SUCCESS) {
-        sysargs->arg1 = (void *) pid;
+    unsigned int psr = USLOSS_PsrGet();
+
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    start->next = freeStarts;
+    freeStarts = start;
+    USLOSS_PsrSet(psr);
+}
+
+/*
+ * StackClass
+ *
+ * Returns the stack size to ask Phase 1 for. Sizes too small for a stack and sizes above the
+ * cap are passed through unchanged.
+ *
+ */
+
+static int
+StackClass(int size)
+{
+    int class = USLOSS_MIN_STACK;
+
+    if ((size < USLOSS_MIN_STACK) || (size > stackCap)) {
+        return size;
+    }
+    while (class < size) {
+        class *= 2;
+    }
+    return class;
+}
+
+/*
+ * FindStackStats
+ *
+ * Returns the index in stackStats of the name, adding it if it is new, or -1 if there is no
+ * room for it. Must be called with procLock held.
+ *
+ */
+
+static int
+FindStackStats(char *name)
+{
+    int i;
+
+    if (name == NULL) {
+        return -1;
+    }
+    for (i = 0; i < numStackStats; i++) {
+        if (strncmp(stackStats[i].name, name, P1_MAXNAME) == 0) {
+            return i;
+        }
+    }
+    if (numStackStats == P2_STACK_NAMES) {
+        return -1;
+    }
+    memset(&stackStats[i], 0, sizeof(P2_StackStats));
+    strncpy(stackStats[i].name, name, P1_MAXNAME);
+    numStackStats++;
+    return i;
+}
+
+/*
+ * AdaptStack
+ *
+ * Returns the stack size for a process spawned with the name of entry that asked for size. In
+ * P2_STACK_ADAPTIVE mode, once a process with the name has been measured, that is the most any of
+ * them used plus P2_STACK_MARGIN percent, but never less than USLOSS_MIN_STACK nor more than was
+ * asked for.
+ *
+ */
+
+static int
+AdaptStack(P2_StackStats *entry, int size)
+{
+    int adapted;
+
+    if ((stackMode != P2_STACK_ADAPTIVE) || (entry->measured == 0)) {
+        return size;
+    }
+    adapted = entry->maxUsed + entry->maxUsed * P2_STACK_MARGIN / 100;
+    if (adapted < USLOSS_MIN_STACK) {
+        adapted = USLOSS_MIN_STACK;
+    }
+    return (adapted < size) ? adapted : size;
+}
+
+/*
+ * Paint
+ *
+ * Fills a process's stack of size bytes with STACK_PAINT, from STACK_RESERVE bytes above its
+ * lowest possible start up to STACK_GAP bytes below the frame of Launch, which is at top.
+ *
+ */
+
+static void 
+Paint(Proc *proc, uintptr_t top, int size, int stats)
+{
+    uintptr_t low = top - size + STACK_RESERVE;
+
+    low = (low + sizeof(unsigned int) - 1) & ~(uintptr_t) (sizeof(unsigned int) - 1);
+    proc->stackTop = top;
+    proc->stackLow = (unsigned int *) low;
+    proc->stackSize = size;
+    proc->stackUsed = -1;
+    proc->stackStats = stats;
+    for (uintptr_t word = low; word < top - STACK_GAP; word += sizeof(unsigned int)) {
+        *(unsigned int *) word = STACK_PAINT;
+    }
+}
+
+/*
+ * StackUsed
+ *
+ * Returns the most bytes of its stack the process has used below Launch's frame, going by the
+ * lowest word that no longer holds STACK_PAINT, or the whole stack if the lowest painted word
+ * has been overwritten.
+ *
+ */
+
+static int
+StackUsed(Proc *proc)
+{
+    uintptr_t word = (uintptr_t) proc->stackLow;
+
+    if (*proc->stackLow != STACK_PAINT) {
+        return proc->stackSize;
+    }
+    while ((word < proc->stackTop - STACK_GAP) && (*(unsigned int *) word == STACK_PAINT)) {
+        word += sizeof(unsigned int);
+    }
+    return proc->stackTop - word;
+}
+
+/*
+ * Launch
+ *
+ * First function run by a spawned process. Paints its stack if it is to be measured, switches
+ * to user mode, runs the process's function, and terminates with its return value. The stack is
+ * measured when the function returns, before the frames of Sys_Terminate are pushed, so a
+ * process that calls Sys_Terminate itself isn't measured.
+ *
+ */
+
+static int
+Launch(void *arg)
+{
+    Start *start = (Start *) arg;
+    Proc *self = &procs[P1_GetPid()];
+    int (*func)(void *) = start->func;
+    void *funcArg = start->arg;
+    int stackSize = start->stackSize;
+    int stats = start->stackStats;
+    int parent = start->parent;
+    int rc;
+
+    StartFree(start);
+    // the pid may have belonged to a process that terminated without waiting for its children
+    LOCK();
+    Release(P1_GetPid());
+    self->parent = parent;
+    UNLOCK();
+    self->stackLow = NULL;
+    if (stats != -1) {
+        Paint(self, (uintptr_t) __builtin_frame_address(0), stackSize, stats);
+    }
+    self->spawned = TRUE;
+    memset(&self->usage, 0, sizeof(P2_ProcUsage));
+    // switch to user mode
+    USLOSS_PsrSet(USLOSS_PsrGet() & ~USLOSS_PSR_CURRENT_MODE);
+    rc = func(funcArg);
+    if (self->stackLow != NULL) {
+        self->stackUsed = StackUsed(self);
+    }
+    Sys_Terminate(rc);
+    // does not get here
+    return rc;
+}
+
+/*
+ * P2_Spawn
+ *
+ * Spawn a user-level process.
+ *
+ */
+int 
+P2_Spawn(char *name, int(*func)(void *arg), void *arg, int stackSize, int priority, int *pid) 
+{
+    Start *start;
+    int stats = -1;
+    int self;
+    int rc;
+
+    if (func == NULL || pid == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    start = StartAlloc();
+    if (start == NULL) {
+        return P1_TOO_MANY_PROCESSES;
+    }
+    start->func = func;
+    start->arg = arg;
+    start->parent = P1_GetPid();
+    LOCK();
+    Verify(start->parent);
+    procs[start->parent].live++;
+    if (stackMode != P2_STACK_FIXED) {
+        stats = FindStackStats(name);
+    }
+    if (stats != -1) {
+        int adapted = AdaptStack(&stackStats[stats], stackSize);
+
+        // an adapted size is already no bigger than it needs to be
+        stackSize = (adapted != stackSize) ? adapted : StackClass(stackSize);
+        stackStats[stats].spawns++;
+        stackStats[stats].stackSize = stackSize;
+    } else {
+        stackSize = StackClass(stackSize);
+    }
+    UNLOCK();
+    start->stackSize = stackSize;
+    start->stackStats = stats;
+    self = start->parent;
+    rc = P1_Fork(name, Launch, start, stackSize, priority, pid);
+    LOCK();
+    if (rc == P1_SUCCESS) {
+        // in case the parent waits for the child before it runs
+        procs[*pid].parent = self;
+    } else {
+        StartFree(start);
+        procs[self].live--;
+        if (stats != -1) {
+            stackStats[stats].spawns--;
+        }
+    }
+    UNLOCK();
+    return rc;
+}
+
+/*
+ * P2_SpawnSetStackCap
+ *
+ * Sets the largest stack size that P2_Spawn rounds up to a size class. 0, the default, turns
+ * rounding off.
+ *
+ */
+
+int 
+P2_SpawnSetStackCap(int cap)
+{
+    if (cap < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    stackCap = cap;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_SpawnSetStackMode
+ *
+ * Sets whether P2_Spawn measures stack use (P2_STACK_MEASURE), and also sizes stacks from it
+ * (P2_STACK_ADAPTIVE), or neither (P2_STACK_FIXED). Painting a stack costs a pass over all of
+ * it at every spawn, so measuring is off by default.
+ *
+ */
+
+int 
+P2_SpawnSetStackMode(int mode)
+{
+    if ((mode < P2_STACK_FIXED) || (mode > P2_STACK_ADAPTIVE)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    stackMode = mode;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_SpawnStackStats
+ *
+ * Copies the stack use recorded for up to max spawn names into stats, in the order the names
+ * were first spawned, and sets *count to the number copied.
+ *
+ */
+
+int 
+P2_SpawnStackStats(P2_StackStats *stats, int max, int *count)
+{
+    if ((stats == NULL) || (count == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (max < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    LOCK();
+    *count = (max < numStackStats) ? max : numStackStats;
+    memcpy(stats, stackStats, *count * sizeof(P2_StackStats));
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_SpawnMany
+ *
+ * Spawns the count processes described by entries, in order, putting their pids in pids. Stops
+ * at the first one that can't be spawned and returns its error. Sets *spawned to the number of
+ * processes spawned.
+ *
+ */
+
+int 
+P2_SpawnMany(P2_SpawnEntry *entries, int count, int *pids, int *spawned)
+{
+    int rc = P1_SUCCESS;
+
+    if ((entries == NULL) || (pids == NULL) || (spawned == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (count < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    for (*spawned = 0; *spawned < count; (*spawned)++) {
+        P2_SpawnEntry *entry = &entries[*spawned];
+        rc = P2_Spawn(entry->name, entry->func, entry->arg, entry->stackSize, entry->priority,
+                      &pids[*spawned]);
+        if (rc != P1_SUCCESS) {
+            break;
+        }
+    }
+    return rc;
+}
+
+/*
+ * ExitAlloc
+ *
+ * Takes an exit record off the free list and fills it in. Must be called with procLock held.
+ *
+ */
+
+static Exit *
+ExitAlloc(int pid, int status, int joined)
+{
+    Exit *record = freeExits;
+
+    assert(record != NULL);
+    freeExits = record->next;
+    record->pid = pid;
+    record->status = status;
+    record->joined = joined;
+    return record;
+}
+
+/*
+ * ExitFree
+ *
+ * Puts an exit record back on the free list. Must be called with procLock held.
+ *
+ */
+
+static void 
+ExitFree(Exit *record)
+{
+    record->next = freeExits;
+    freeExits = record;
+}
+
+/*
+ * Queue
+ *
+ * Appends an exit record to the parent's queue. Must be called with procLock held.
+ *
+ */
+
+static void 
+Queue(Proc *parent, Exit *record)
+{
+    record->next = NULL;
+    record->prev = parent->tail;
+    if (parent->tail == NULL) {
+        parent->head = record;
+    } else {
+        parent->tail->next = record;
+    }
+    parent->tail = record;
+    parent->exits++;
+}
+
+/*
+ * Unqueue
+ *
+ * Removes an exit record from the parent's queue. Must be called with procLock held.
+ *
+ */
+
+static void 
+Unqueue(Proc *parent, Exit *record)
+{
+    if (record->prev == NULL) {
+        parent->head = record->next;
+    } else {
+        record->prev->next = record->next;
+    }
+    if (record->next == NULL) {
+        parent->tail = record->prev;
+    } else {
+        record->next->prev = record->prev;
+    }
+    parent->exits--;
+}
+
+/*
+ * Release
+ *
+ * Empties the exit queue of a process that is terminating, or whose pid is being reused, and
+ * disowns its spawned children. Those waiting in P2_Terminate to be reaped are woken and quit,
+ * and the rest quit without waiting when they terminate. Must be called with procLock held.
+ *
+ */
+
+static void 
+Release(int pid)
+{
+    Proc *proc = &procs[pid];
+    int rc;
+
+    while (proc->head != NULL) {
+        Exit *record = proc->head;
+
+        Unqueue(proc, record);
+        if (!record->joined) {
+            procs[record->pid].exit = NULL;
+            procs[record->pid].exiting = FALSE;
+            rc = P1_Signal(procs[record->pid].cond);
+            assert(rc == P1_SUCCESS);
+        }
+        ExitFree(record);
+    }
+    proc->live = 0;
+    proc->waitingFor = 0;
+    proc->waitingPid = -1;
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        if (procs[i].parent == pid) {
+            procs[i].parent = -1;
+        }
+    }
+}
+
+/*
+ * Verify
+ *
+ * Releases what an earlier process with the caller's pid left behind. A process that wasn't
+ * spawned can quit without calling P2_Terminate, and Phase 1 then gives its children to the
+ * first process, so if a child recorded as the caller's isn't its child in Phase 1 the whole
+ * entry is left over. Spawned processes release theirs in Launch. Must be called with procLock
+ * held.
+ *
+ */
+
+static void 
+Verify(int pid)
+{
+    P1_ProcInfo info;
+    int rc;
+
+    if (procs[pid].spawned) {
+        return;
+    }
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        if (procs[i].parent != pid) {
+            continue;
+        }
+        rc = P1_GetProcInfo(i, &info);
+        if ((rc != P1_SUCCESS) || (info.state == P1_STATE_FREE) || (info.parent != pid)) {
+            Release(pid);
+            return;
+        }
+    }
+}
+
+/*
+ * Reap
+ *
+ * Removes an exit record from the parent's queue, returns the child's pid and status, and joins
+ * the child. A spawned child is waiting in P2_Terminate to be reaped, so it quits as soon as it
+ * is woken. P1_Join can return any child that has quit, and any other than this one wasn't
+ * created by P2_Spawn; it is queued so that a later wait returns it. Must be called with
+ * procLock held, which is released while joining.
+ *
+ */
+
+static void 
+Reap(Proc *parent, Exit *record, int *pid, int *status)
+{
+    int joined;
+    int joinedStatus;
+    int rc;
+
+    Unqueue(parent, record);
+    *pid = record->pid;
+    *status = record->status;
+    if (!record->joined) {
+        procs[*pid].exit = NULL;
+        procs[*pid].exiting = FALSE;
+        procs[*pid].parent = -1;
+        rc = P1_Signal(procs[*pid].cond);
+        assert(rc == P1_SUCCESS);
+        UNLOCK();
+        do {
+            rc = P1_Join(&joined, &joinedStatus);
+            assert(rc == P1_SUCCESS);
+            if (joined != *pid) {
+                LOCK();
+                Queue(parent, ExitAlloc(joined, joinedStatus, TRUE));
+                UNLOCK();
+            }
+        } while (joined != *pid);
+        LOCK();
+    }
+    ExitFree(record);
+}
+
+/*
+ * P2_Wait
+ *
+ * Wait for a user-level process. Returns the child that exited first. While the caller has
+ * spawned children that haven't exited, only they are waited for.
+ *
+ */
+
+int 
+P2_Wait(int *pid, int *status) 
+{
+    Proc *parent = &procs[P1_GetPid()];
+    int rc;
+
+    if (pid == NULL || status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    LOCK();
+    Verify(P1_GetPid());
+    while ((parent->exits == 0) && (parent->live > 0)) {
+        parent->waitingFor = 1;
+        rc = P1_Wait(parent->cond);
+        assert(rc == P1_SUCCESS);
+    }
+    parent->waitingFor = 0;
+    if (parent->exits > 0) {
+        Reap(parent, parent->head, pid, status);
+        UNLOCK();
+        return P1_SUCCESS;
+    }
+    UNLOCK();
+    // only children that weren't spawned are left
+    return P1_Join(pid, status);
+}
+
+/*
+ * P2_WaitPid
+ *
+ * Waits for the specified child, which must have been created by P2_Spawn. Other children that
+ * exit in the meantime stay queued for later waits.
+ *
+ */
+
+int 
+P2_WaitPid(int pid, int *status)
+{
+    int self = P1_GetPid();
+    Proc *parent = &procs[self];
+    P1_ProcInfo info;
+    int waited;
+    int rc;
+
+    if (status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return P1_INVALID_PID;
+    }
+    // the child hasn't been joined yet, so Phase 1 still knows its parent
+    rc = P1_GetProcInfo(pid, &info);
+    if ((rc != P1_SUCCESS) || (info.state == P1_STATE_FREE) || (info.parent != self)) {
+        return P1_INVALID_PID;
+    }
+    LOCK();
+    Verify(self);
+    if (procs[pid].parent != self) {
+        // created by P1_Fork
+        UNLOCK();
+        return P2_NOT_SPAWNED;
+    }
+    while (procs[pid].exit == NULL) {
+        parent->waitingPid = pid;
+        rc = P1_Wait(parent->cond);
+        assert(rc == P1_SUCCESS);
+    }
+    parent->waitingPid = -1;
+    Reap(parent, procs[pid].exit, &waited, status);
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_WaitNoHang
+ *
+ * Returns the child that exited first without waiting. Sets *pid to -1 if spawned children
+ * remain but none has exited.
+ *
+ */
+
+int 
+P2_WaitNoHang(int *pid, int *status)
+{
+    Proc *parent = &procs[P1_GetPid()];
+    int rc = P1_SUCCESS;
+
+    if (pid == NULL || status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    LOCK();
+    Verify(P1_GetPid());
+    if (parent->exits > 0) {
+        Reap(parent, parent->head, pid, status);
+    } else if (parent->live > 0) {
+        *pid = -1;
+    } else {
+        rc = P1_NO_CHILDREN;
+    }
+    UNLOCK();
+    return rc;
+}
+
+/*
+ * P2_WaitN
+ *
+ * Waits for n spawned children, or for all of them if there are fewer, and puts their pids and
+ * statuses in pids and statuses in the order they exited. The caller sleeps until that many have
+ * exited and is woken once, rather than once per child. Sets *count to the number of children
+ * waited for.
+ *
+ */
+
+int 
+P2_WaitN(int n, int *pids, int *statuses, int *count)
+{
+    Proc *parent = &procs[P1_GetPid()];
+    int rc;
+
+    if ((pids == NULL) || (statuses == NULL) || (count == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (n < 1) {
+        return P2_INVALID_ARGUMENT;
+    }
+    *count = 0;
+    LOCK();
+    Verify(P1_GetPid());
+    if (parent->exits + parent->live == 0) {
+        UNLOCK();
+        return P1_NO_CHILDREN;
+    }
+    if (n > parent->exits + parent->live) {
+        n = parent->exits + parent->live;
+    }
+    while (parent->exits < n) {
+        parent->waitingFor = n;
+        rc = P1_Wait(parent->cond);
+        assert(rc == P1_SUCCESS);
+    }
+    parent->waitingFor = 0;
+    for (; *count < n; (*count)++) {
+        Reap(parent, parent->head, &pids[*count], &statuses[*count]);
+    }
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * P2ProcExiting
+ *
+ * Returns TRUE if the process has called P2_Terminate and not yet been joined, so that joining
+ * its parent will not block for long.
+ *
+ */
+
+int 
+P2ProcExiting(int pid)
+{
+    return procs[pid].exiting;
+}
+
+/*
+ * P2ProcWaitReady
+ *
+ * Returns TRUE if P2_Wait would return one of the process's spawned children without blocking
+ * for long, because one has exited or is in P2_Terminate, FALSE if it would block, and
+ * P1_NO_CHILDREN if the process has no spawned children left.
+ *
+ */
+
+int 
+P2ProcWaitReady(int pid)
+{
+    int ready;
+
+    LOCK();
+    Verify(pid);
+    ready = (procs[pid].exits > 0);
+    for (int i = 0; !ready && (i < P1_MAXPROC); i++) {
+        ready = (procs[i].parent == pid) && procs[i].exiting;
+    }
+    if (!ready && (procs[pid].live == 0)) {
+        ready = P1_NO_CHILDREN;
+    }
+    UNLOCK();
+    return ready;
+}
+
+/*
+ * P2ProcAccount
+ *
+ * Returns the resource counters of the process, so that other parts of Phase 2 can charge it.
+ *
+ */
+
+P2_ProcUsage *
+P2ProcAccount(int pid)
+{
+    return &procs[pid].usage;
+}
+
+/*
+ * P2_GetProcUsage
+ *
+ * Copies the resources used by the process into usage. The counters start when P2_Spawn creates
+ * the process and stay available after it exits until its parent waits for it.
+ *
+ */
+
+int 
+P2_GetProcUsage(int pid, P2_ProcUsage *usage)
+{
+    P1_ProcInfo info;
+    int rc;
+
+    if (usage == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return P1_INVALID_PID;
+    }
+    rc = P1_GetProcInfo(pid, &info);
+    if ((rc != P1_SUCCESS) || (info.state == P1_STATE_FREE)) {
+        return P1_INVALID_PID;
+    }
+    *usage = procs[pid].usage;
+    usage->userTime = info.cpu - usage->kernelTime;
+    if (usage->userTime < 0) {
+        usage->userTime = 0;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_GetProcSnapshot
+ *
+ * Copies the pid and P1_ProcInfo of up to max live processes into buffer, in pid order, and sets
+ * *count to the number copied. If states isn't 0 only processes in the states it selects (see
+ * P2_STATE) are copied.
+ *
+ */
+
+int 
+P2_GetProcSnapshot(P2_ProcSnapshot *buffer, int max, int states, int *count)
+{
+    int rc;
+
+    if ((buffer == NULL) || (count == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (max < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    *count = 0;
+    for (int pid = 0; (pid < P1_MAXPROC) && (*count < max); pid++) {
+        P2_ProcSnapshot *entry = &buffer[*count];
+        // fill in the next entry, and keep it if the process is wanted
+        rc = P1_GetProcInfo(pid, &entry->info);
+        if ((rc == P1_SUCCESS) && (entry->info.state != P1_STATE_FREE) &&
+            ((states == 0) || (states & P2_STATE(entry->info.state)))) {
+            entry->pid = pid;
+            (*count)++;
+        }
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * FutexBucket
+ *
+ * Returns the futex queue for the address.
+ *
+ */
+
+static int *
+FutexBucket(int *addr)
+{
+    return &futexes[((unsigned long) addr / sizeof(int)) & (FUTEX_BUCKETS - 1)];
+}
+
+/*
+ * P2_FutexWait
+ *
+ * Blocks the caller until P2_FutexWake is called on addr, provided *addr is still expected.
+ * Otherwise returns at once, because whatever the caller was waiting for may have happened.
+ * Checking *addr and queueing the caller are done with procLock held, which P2_FutexWake also
+ * holds, so a wakeup between a user-level check and the wait isn't lost. Callers must check
+ * their condition again when this returns.
+ *
+ */
+
+int 
+P2_FutexWait(int *addr, int expected)
+{
+    int pid = P1_GetPid();
+    int *next;
+    int rc;
+
+    if (addr == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    LOCK();
+    if (*addr == expected) {
+        // append to the queue
+        for (next = FutexBucket(addr); *next != -1; next = &procs[*next].nextFutex) {
+        }
+        *next = pid;
+        procs[pid].nextFutex = -1;
+        procs[pid].futex = addr;
+        while (procs[pid].futex != NULL) {
+            rc = P1_Wait(procs[pid].cond);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_FutexWake
+ *
+ * Wakes up to max of the processes waiting on addr, longest waiting first, and sets *woken to
+ * the number woken.
+ *
+ */
+
+int 
+P2_FutexWake(int *addr, int max, int *woken)
+{
+    int *next;
+    int pid;
+    int rc;
+
+    if ((addr == NULL) || (woken == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (max < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    *woken = 0;
+    LOCK();
+    next = FutexBucket(addr);
+    while ((*next != -1) && (*woken < max)) {
+        pid = *next;
+        if (procs[pid].futex == addr) {
+            *next = procs[pid].nextFutex;
+            procs[pid].futex = NULL;
+            rc = P1_Signal(procs[pid].cond);
+            assert(rc == P1_SUCCESS);
+            (*woken)++;
+        } else {
+            next = &procs[pid].nextFutex;
+        }
+    }
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_MboxCreate
+ *
+ * Creates a mailbox that holds up to slots messages. Returns P2_INVALID_MBOX if all mailboxes are
+ * in use.
+ *
+ */
+
+int 
+P2_MboxCreate(int slots, int *mbox)
+{
+    int result = P2_INVALID_MBOX;
+
+    if (mbox == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if ((slots < 1) || (slots > P2_MAX_SLOTS)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    MBOX_LOCK();
+    for (int i = 0; i < P2_MAX_MBOXES; i++) {
+        if (!mboxes[i].inUse) {
+            mboxes[i].inUse = TRUE;
+            mboxes[i].slots = slots;
+            mboxes[i].count = 0;
+            mboxes[i].head = 0;
+            mboxes[i].senders = 0;
+            mboxes[i].receivers = 0;
+            *mbox = i;
+            result = P1_SUCCESS;
+            break;
+        }
+    }
+    MBOX_UNLOCK();
+    return result;
+}
+
+/*
+ * P2_MboxRelease
+ *
+ * Frees a mailbox. Fails if processes are waiting on it, or if it still holds messages: their
+ * buffers are only referenced by the mailbox, so they must be received first.
+ *
+ */
+
+int 
+P2_MboxRelease(int mbox)
+{
+    int rc = P1_SUCCESS;
+
+    if ((mbox < 0) || (mbox >= P2_MAX_MBOXES)) {
+        return P2_INVALID_MBOX;
+    }
+    MBOX_LOCK();
+    if (!mboxes[mbox].inUse) {
+        rc = P2_INVALID_MBOX;
+    } else if ((mboxes[mbox].senders > 0) || (mboxes[mbox].receivers > 0)) {
+        rc = P1_BLOCKED_PROCESSES;
+    } else if (mboxes[mbox].count > 0) {
+        rc = P2_MBOX_NOT_EMPTY;
+    } else {
+        mboxes[mbox].inUse = FALSE;
+        // waiting for a released mailbox ends, and the next call on it fails
+        P2EventNotify(P2_EVENT_MBOX_RECV, mbox);
+        P2EventNotify(P2_EVENT_MBOX_SEND, mbox);
+    }
+    MBOX_UNLOCK();
+    return rc;
+}
+
+/*
+ * Put
+ *
+ * Appends a message to the mailbox, waiting for a free slot if wait is TRUE, otherwise returning
+ * P2_WOULD_BLOCK if the mailbox is full. Only the reference to the buffer is stored.
+ *
+ */
+
+static int
+Put(int mbox, void *buffer, int size, int wait)
+{
+    Mbox *box;
+    int result = P1_SUCCESS;
+    int rc;
+
+    if ((mbox < 0) || (mbox >= P2_MAX_MBOXES)) {
+        return P2_INVALID_MBOX;
+    }
+    if (size < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    box = &mboxes[mbox];
+    MBOX_LOCK();
+    while (box->inUse && (box->count == box->slots) && wait) {
+        box->senders++;
+        rc = P1_Wait(box->notFull);
+        assert(rc == P1_SUCCESS);
+        box->senders--;
+    }
+    if (!box->inUse) {
+        result = P2_INVALID_MBOX;
+    } else if (box->count == box->slots) {
+        result = P2_WOULD_BLOCK;
+    } else {
+        Message *message = &box->messages[(box->head + box->count) % box->slots];
+        message->buffer = buffer;
+        message->size = size;
+        box->count++;
+        if (box->receivers > 0) {
+            rc = P1_Signal(box->notEmpty);
+            assert(rc == P1_SUCCESS);
+        }
+        P2EventNotify(P2_EVENT_MBOX_RECV, mbox);
+    }
+    MBOX_UNLOCK();
+    return result;
+}
+
+/*
+ * Get
+ *
+ * Removes the oldest message from the mailbox, waiting for one if wait is TRUE, otherwise
+ * returning P2_WOULD_BLOCK if the mailbox is empty.
+ *
+ */
+
+static int
+Get(int mbox, void **buffer, int *size, int wait)
+{
+    Mbox *box;
+    int result = P1_SUCCESS;
+    int rc;
+
+    if ((mbox < 0) || (mbox >= P2_MAX_MBOXES)) {
+        return P2_INVALID_MBOX;
+    }
+    if ((buffer == NULL) || (size == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    box = &mboxes[mbox];
+    MBOX_LOCK();
+    while (box->inUse && (box->count == 0) && wait) {
+        box->receivers++;
+        rc = P1_Wait(box->notEmpty);
+        assert(rc == P1_SUCCESS);
+        box->receivers--;
+    }
+    if (!box->inUse) {
+        result = P2_INVALID_MBOX;
+    } else if (box->count == 0) {
+        result = P2_WOULD_BLOCK;
+    } else {
+        Message *message = &box->messages[box->head];
+        *buffer = message->buffer;
+        *size = message->size;
+        box->head = (box->head + 1) % box->slots;
+        box->count--;
+        if (box->senders > 0) {
+            rc = P1_Signal(box->notFull);
+            assert(rc == P1_SUCCESS);
+        }
+        P2EventNotify(P2_EVENT_MBOX_SEND, mbox);
+    }
+    MBOX_UNLOCK();
+    return result;
+}
+
+/*
+ * P2_MboxSend
+ *
+ * Sends the buffer to the mailbox, waiting while it is full. The buffer isn't copied: it is
+ * handed to the receiver, and the sender must not use it afterwards.
+ *
+ */
+
+int 
+P2_MboxSend(int mbox, void *buffer, int size)
+{
+    return Put(mbox, buffer, size, TRUE);
+}
+
+/*
+ * P2_MboxReceive
+ *
+ * Receives the oldest message in the mailbox, waiting while it is empty. The caller now owns
+ * *buffer, which holds *size bytes.
+ *
+ */
+
+int 
+P2_MboxReceive(int mbox, void **buffer, int *size)
+{
+    return Get(mbox, buffer, size, TRUE);
+}
+
+/*
+ * P2_MboxCondSend
+ *
+ * Like P2_MboxSend, but returns P2_WOULD_BLOCK instead of waiting.
+ *
+ */
+
+int 
+P2_MboxCondSend(int mbox, void *buffer, int size)
+{
+    return Put(mbox, buffer, size, FALSE);
+}
+
+/*
+ * P2_MboxCondReceive
+ *
+ * Like P2_MboxReceive, but returns P2_WOULD_BLOCK instead of waiting.
+ *
+ */
+
+int 
+P2_MboxCondReceive(int mbox, void **buffer, int *size)
+{
+    return Get(mbox, buffer, size, FALSE);
+}
+
+/*
+ * P2AddEventSource
+ *
+ * Registers the readiness test of an event type. P2_WaitEvents calls it without holding any
+ * lock; it returns TRUE if the event with the given id has happened, and also if the id doesn't
+ * name anything, so that the caller finds out when it uses the id.
+ *
+ */
+
+void 
+P2AddEventSource(int type, int (*ready)(int id))
+{
+    assert((type >= 0) && (type < P2_EVENT_TYPES));
+    eventSources[type] = ready;
+}
+
+/*
+ * Wake
+ *
+ * Wakes the process if it is in P2_WaitEvents and one of its events has the type and id. An event
+ * with id -1 matches any id. Must be called with procLock held.
+ *
+ */
+
+static void 
+Wake(Proc *proc, int type, int id)
+{
+    int rc;
+
+    for (int i = 0; i < proc->numEvents; i++) {
+        if ((proc->events[i].type == type) &&
+            ((proc->events[i].id == id) || (proc->events[i].id == -1))) {
+            proc->notified = TRUE;
+            rc = P1_Signal(proc->cond);
+            assert(rc == P1_SUCCESS);
+            break;
+        }
+    }
+}
+
+/*
+ * P2EventNotify
+ *
+ * Called by the owner of an event source when the event with the type and id may have happened.
+ * The processes waiting for it poll their events again. Only the processes waiting for an event
+ * of the type are looked at; when there are none the only cost is the test of eventWaiters.
+ *
+ */
+
+void 
+P2EventNotify(int type, int id)
+{
+    if (eventWaiters[type] == -1) {
+        return;
+    }
+    LOCK();
+    for (int pid = eventWaiters[type]; pid != -1; pid = procs[pid].nextWaiter[type]) {
+        Wake(&procs[pid], type, id);
+    }
+    UNLOCK();
+}
+
+/*
+ * Listen
+ *
+ * Adds the process to, or with listen FALSE removes it from, the waiter lists of the types of its
+ * events. Must be called with procLock held.
+ *
+ */
+
+static void 
+Listen(int pid, int listen)
+{
+    Proc *proc = &procs[pid];
+    int done = 0; // bit t set once type t is handled
+
+    for (int i = 0; i < proc->numEvents; i++) {
+        int type = proc->events[i].type;
+        int *next;
+
+        if (done & (1 << type)) {
+            continue;
+        }
+        done |= 1 << type;
+        if (listen) {
+            proc->nextWaiter[type] = eventWaiters[type];
+            eventWaiters[type] = pid;
+        } else {
+            for (next = &eventWaiters[type]; *next != pid; next = &procs[*next].nextWaiter[type]) {
+                assert(*next != -1);
+            }
+            *next = proc->nextWaiter[type];
+            proc->nextWaiter[type] = -1;
+        }
+    }
+}
+
+/*
+ * Poll
+ *
+ * Sets the ready field of each event and returns how many are ready.
+ *
+ */
+
+static int
+Poll(P2_Event *events, int count)
+{
+    int ready = 0;
+
+    for (int i = 0; i < count; i++) {
+        events[i].ready = eventSources[events[i].type](events[i].id) ? TRUE : FALSE;
+        ready += events[i].ready;
+    }
+    return ready;
+}
+
+/*
+ * P2_WaitEvents
+ *
+ * Waits until at least one of the events has happened, then sets the ready field of every event
+ * that has and the number of them in *ready. Nothing is consumed: the caller collects each ready
+ * event with the usual call (P2_WaitPid, P2_MboxCondReceive, P2_TimerWait, P2_DiskCollect...),
+ * which won't block. Returns at once if an event is already ready.
+ *
+ */
+
+int 
+P2_WaitEvents(P2_Event *events, int count, int *ready)
+{
+    int pid = P1_GetPid();
+    Proc *self = &procs[pid];
+    int rc;
+
+    if ((events == NULL) || (ready == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if ((count < 1) || (count > P2_MAX_EVENTS)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    for (int i = 0; i < count; i++) {
+        if ((events[i].type < 0) || (events[i].type >= P2_EVENT_TYPES) ||
+            (eventSources[events[i].type] == NULL)) {
+            return P2_INVALID_ARGUMENT;
+        }
+    }
+    LOCK();
+    self->events = events;
+    self->numEvents = count;
+    self->notified = FALSE;
+    Listen(pid, TRUE);
+    UNLOCK();
+    // a notification after a poll sets notified, so the wait below doesn't miss it
+    while ((*ready = Poll(events, count)) == 0) {
+        LOCK();
+        while (!self->notified) {
+            rc = P1_Wait(self->cond);
+            assert(rc == P1_SUCCESS);
+        }
+        self->notified = FALSE;
+        UNLOCK();
+    }
+    LOCK();
+    Listen(pid, FALSE);
+    self->numEvents = 0;
+    UNLOCK();
+    return P1_SUCCESS;
+}
+
+/*
+ * ChildReady
+ *
+ * Event source for P2_EVENT_CHILD. The child with pid has exited, or with pid -1 any child of the
+ * caller has. A caller with no spawned children left is told so by P2_Wait.
+ *
+ */
+
+static int
+ChildReady(int pid)
+{
+    int self = P1_GetPid();
+    P1_ProcInfo info;
+    int ready;
+    int rc;
+
+    if (pid == -1) {
+        LOCK();
+        Verify(self);
+        ready = (procs[self].exits > 0) || (procs[self].live == 0);
+        UNLOCK();
+        return ready;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return TRUE;
+    }
+    rc = P1_GetProcInfo(pid, &info);
+    if ((rc != P1_SUCCESS) || (info.state == P1_STATE_FREE) || (info.parent != self)) {
+        return TRUE;
+    }
+    LOCK();
+    // P2_WaitPid doesn't wait for children that weren't spawned
+    ready = (procs[pid].parent != self) || (procs[pid].exit != NULL);
+    UNLOCK();
+    return ready;
+}
+
+/*
+ * MboxReceivable
+ *
+ * Event source for P2_EVENT_MBOX_RECV. The mailbox has a message.
+ *
+ */
+
+static int
+MboxReceivable(int mbox)
+{
+    int ready;
+
+    if ((mbox < 0) || (mbox >= P2_MAX_MBOXES)) {
+        return TRUE;
+    }
+    MBOX_LOCK();
+    ready = !mboxes[mbox].inUse || (mboxes[mbox].count > 0);
+    MBOX_UNLOCK();
+    return ready;
+}
+
+/*
+ * MboxSendable
+ *
+ * Event source for P2_EVENT_MBOX_SEND. The mailbox has a free slot.
+ *
+ */
+
+static int
+MboxSendable(int mbox)
+{
+    int ready;
+
+    if ((mbox < 0) || (mbox >= P2_MAX_MBOXES)) {
+        return TRUE;
+    }
+    MBOX_LOCK();
+    ready = !mboxes[mbox].inUse || (mboxes[mbox].count < mboxes[mbox].slots);
+    MBOX_UNLOCK();
+    return ready;
+}
+
+/*
+ * P2_Terminate
+ *
+ * Terminate a user-level process. The process is queued on its parent and waits there until the
+ * parent reaps it, so that the parent can wait for a particular child.
+ *
+ */
+
+int 
+P2_Terminate(int status) 
+{
+    int pid = P1_GetPid();
+    Proc *self = &procs[pid];
+    P1_ProcInfo info;
+    Proc *parent;
+    int rc;
+
+    if (!self->spawned) {
+        return P2_NOT_SPAWNED;
+    }
+    self->exiting = TRUE;
+    for (int i = 0; i < numExitHooks; i++) {
+        exitHooks[i](pid);
+    }
+    self->spawned = FALSE;
+
+    rc = P1_GetProcInfo(pid, &info);
+    assert(rc == P1_SUCCESS);
+    LOCK();
+    if ((self->stackLow != NULL) && (self->stackUsed != -1)) {
+        P2_StackStats *entry = &stackStats[self->stackStats];
+
+        entry->measured++;
+        if (self->stackUsed > entry->maxUsed) {
+            entry->maxUsed = self->stackUsed;
+        }
+    }
+    self->stackLow = NULL;
+    Release(pid);
+    if ((self->parent != -1) && (info.parent != self->parent)) {
+        // the parent quit without P2_Terminate and Phase 1 gave this process to another
+        Release(self->parent);
+    }
+    if (self->parent == -1) {
+        // no one will wait for it
+        self->exiting = FALSE;
+    } else {
+        parent = &procs[self->parent];
+        self->exit = ExitAlloc(pid, status, FALSE);
+        Queue(parent, self->exit);
+        parent->live--;
+        if (((parent->waitingFor > 0) && (parent->exits >= parent->waitingFor)) ||
+            (parent->waitingPid == pid)) {
+            rc = P1_Signal(parent->cond);
+            assert(rc == P1_SUCCESS);
+        }
+        Wake(parent, P2_EVENT_CHILD, pid);
+        while (self->exit != NULL) {
+            rc = P1_Wait(self->cond);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+    UNLOCK();
+    // the system call that got here never returns
+    self->calls = 0;
+    P1_Quit(status);
+    // does not get here
+    return P1_SUCCESS;
+
+}
+
+/*
+ * SpawnStub
+ *
+ * Stub for Sys_Spawn system call. 
+ *
+ */
+
+static void 
+SpawnStub(USLOSS_Sysargs *sysargs) 
+{
+    int (*func)(void *) = sysargs->arg1;
+    void *arg = sysargs->arg2;
+    int stackSize = (int) sysargs->arg3;
+    int priority = (int) sysargs->arg4;
+    char *name = sysargs->arg5;
+    int pid;
+    int rc = P2_Spawn(name, func, arg, stackSize, priority, &pid);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitStub
+ *
+ * Stub for Sys_Wait system call.
+ *
+ */
+
+static void 
+WaitStub(USLOSS_Sysargs *sysargs) 
+{
+    int pid;
+    int status;
+    int rc = P2_Wait(&pid, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TerminateStub
+ *
+ * Stub for Sys_Terminate system call.
+ *
+ */
+
+static void 
+TerminateStub(USLOSS_Sysargs *sysargs) 
+{
+    int status = (int) sysargs->arg1;
+    int rc = P2_Terminate(status);
+    // only returns if the caller wasn't spawned
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * GetTimeOfDayStub
+ *
+ * Stub for Sys_GetTimeOfDay system call.
+ *
+ */
+
+static void 
+GetTimeOfDayStub(USLOSS_Sysargs *sysargs) 
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    sysargs->arg1 = (void *) now;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * GetProcInfoStub
+ *
+ * Stub for Sys_GetProcInfo system call.
+ *
+ */
+
+static void 
+GetProcInfoStub(USLOSS_Sysargs *sysargs) 
+{
+    int pid = (int) sysargs->arg1;
+    P1_ProcInfo *info = sysargs->arg2;
+    int rc = P1_GetProcInfo(pid, info);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * GetPidStub
+ *
+ * Stub for Sys_GetPid system call.
+ *
+ */
+
+static void 
+GetPidStub(USLOSS_Sysargs *sysargs) 
+{
+    sysargs->arg1 = (void *) P1_GetPid();
+    sysargs->arg4 = (void *) P1_SUCCESS;
+}
+
+/*
+ * SyscallStatsStub
+ *
+ * Stub for Sys_SyscallStats system call.
+ *
+ */
+
+static void 
+SyscallStatsStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_SyscallStats((unsigned int) sysargs->arg1, sysargs->arg2);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * BatchStub
+ *
+ * Stub for Sys_Batch system call.
+ *
+ */
+
+static void 
+BatchStub(USLOSS_Sysargs *sysargs) 
+{
+    int done = 0;
+    int rc = P2_Batch(sysargs->arg1, (int) sysargs->arg2, (int) sysargs->arg3, &done);
+    sysargs->arg1 = (void *) done;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TraceControlStub
+ *
+ * Stub for Sys_TraceControl system call.
+ *
+ */
+
+static void 
+TraceControlStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_TraceControl((int) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TraceReadStub
+ *
+ * Stub for Sys_TraceRead system call.
+ *
+ */
+
+static void 
+TraceReadStub(USLOSS_Sysargs *sysargs) 
+{
+    int count = 0;
+    int rc = P2_TraceRead(sysargs->arg1, (int) sysargs->arg2, &count);
+    sysargs->arg2 = (void *) count;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * SpawnManyStub
+ *
+ * Stub for Sys_SpawnMany system call.
+ *
+ */
+
+static void 
+SpawnManyStub(USLOSS_Sysargs *sysargs) 
+{
+    int spawned = 0;
+    int rc = P2_SpawnMany(sysargs->arg1, (int) sysargs->arg2, sysargs->arg3, &spawned);
+    sysargs->arg1 = (void *) spawned;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitNStub
+ *
+ * Stub for Sys_WaitN system call.
+ *
+ */
+
+static void 
+WaitNStub(USLOSS_Sysargs *sysargs) 
+{
+    int count = 0;
+    int rc = P2_WaitN((int) sysargs->arg1, sysargs->arg2, sysargs->arg3, &count);
+    sysargs->arg1 = (void *) count;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitPidStub
+ *
+ * Stub for Sys_WaitPid system call.
+ *
+ */
+
+static void 
+WaitPidStub(USLOSS_Sysargs *sysargs) 
+{
+    int status;
+    int rc = P2_WaitPid((int) sysargs->arg1, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitNoHangStub
+ *
+ * Stub for Sys_WaitNoHang system call.
+ *
+ */
+
+static void 
+WaitNoHangStub(USLOSS_Sysargs *sysargs) 
+{
+    int pid;
+    int status = 0;
+    int rc = P2_WaitNoHang(&pid, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * GetProcUsageStub
+ *
+ * Stub for Sys_GetProcUsage system call.
+ *
+ */
+
+static void 
+GetProcUsageStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_GetProcUsage((int) sysargs->arg1, sysargs->arg2);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * GetProcSnapshotStub
+ *
+ * Stub for Sys_GetProcSnapshot system call.
+ *
+ */
+
+static void 
+GetProcSnapshotStub(USLOSS_Sysargs *sysargs) 
+{
+    int count = 0;
+    int rc = P2_GetProcSnapshot(sysargs->arg1, (int) sysargs->arg2, (int) sysargs->arg3, &count);
+    sysargs->arg2 = (void *) count;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * FutexWaitStub
+ *
+ * Stub for Sys_FutexWait system call.
+ *
+ */
+
+static void 
+FutexWaitStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_FutexWait(sysargs->arg1, (int) sysargs->arg2);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * FutexWakeStub
+ *
+ * Stub for Sys_FutexWake system call.
+ *
+ */
+
+static void 
+FutexWakeStub(USLOSS_Sysargs *sysargs) 
+{
+    int woken = 0;
+    int rc = P2_FutexWake(sysargs->arg1, (int) sysargs->arg2, &woken);
+    sysargs->arg2 = (void *) woken;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxCreateStub
+ *
+ * Stub for Sys_MailboxCreate system call.
+ *
+ */
+
+static void 
+MboxCreateStub(USLOSS_Sysargs *sysargs) 
+{
+    int mbox;
+    int rc = P2_MboxCreate((int) sysargs->arg1, &mbox);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) mbox;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxReleaseStub
+ *
+ * Stub for Sys_MailboxRelease system call.
+ *
+ */
+
+static void 
+MboxReleaseStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_MboxRelease((int) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxSendStub
+ *
+ * Stub for Sys_MailboxSend system call.
+ *
+ */
+
+static void 
+MboxSendStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_MboxSend((int) sysargs->arg1, sysargs->arg2, (int) sysargs->arg3);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxReceiveStub
+ *
+ * Stub for Sys_MailboxReceive system call.
+ *
+ */
+
+static void 
+MboxReceiveStub(USLOSS_Sysargs *sysargs) 
+{
+    void *buffer;
+    int size;
+    int rc = P2_MboxReceive((int) sysargs->arg1, &buffer, &size);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg2 = buffer;
+        sysargs->arg3 = (void *) size;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxCondSendStub
+ *
+ * Stub for Sys_MailboxCondSend system call.
+ *
+ */
+
+static void 
+MboxCondSendStub(USLOSS_Sysargs *sysargs) 
+{
+    int rc = P2_MboxCondSend((int) sysargs->arg1, sysargs->arg2, (int) sysargs->arg3);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * MboxCondReceiveStub
+ *
+ * Stub for Sys_MailboxCondReceive system call.
+ *
+ */
+
+static void 
+MboxCondReceiveStub(USLOSS_Sysargs *sysargs) 
+{
+    void *buffer;
+    int size;
+    int rc = P2_MboxCondReceive((int) sysargs->arg1, &buffer, &size);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg2 = buffer;
+        sysargs->arg3 = (void *) size;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitEventsStub
+ *
+ * Stub for Sys_WaitEvents system call.
+ *
+ */
+
+static void 
+WaitEventsStub(USLOSS_Sysargs *sysargs) 
+{
+    int ready;
+    int rc = P2_WaitEvents(sysargs->arg1, (int) sysargs->arg2, &ready);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) ready;
     }
     sysargs->arg4 = (void *) rc;
 }
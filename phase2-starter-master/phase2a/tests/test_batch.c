@@ -0,0 +1,102 @@
+/*
+ * test_batch.c
+ *
+ * Tests Sys_Batch. A batch of Sys_GetPid and Sys_GetTimeOfDay calls with a failing Sys_Wait in
+ * the middle must run every call, or stop at the Sys_Wait if asked to. Each record holds its own
+ * results, and the calls are counted as if they had been made one at a time.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define NUMCALLS 5
+
+static int p3Pid = -1;
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0, done;
+
+    P2ProcInit();
+    rc = P2_Batch(NULL, 1, FALSE, &done);
+    TEST_RC(rc, P2_NULL_ADDRESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+/*
+ * Fill
+ *
+ * Sets up the batch: two Sys_GetPid, a Sys_Wait that fails because there are no children, a
+ * Sys_GetTimeOfDay and a nested Sys_Batch, which is rejected.
+ */
+
+static void Fill(USLOSS_Sysargs *calls)
+{
+    memset(calls, 0, NUMCALLS * sizeof(USLOSS_Sysargs));
+    calls[0].number = SYS_GETPID;
+    calls[1].number = SYS_GETPID;
+    calls[2].number = SYS_WAIT;
+    calls[3].number = SYS_GETTIMEOFDAY;
+    calls[4].number = SYS_BATCH;
+}
+
+int P3_Startup(void *arg) {
+    int rc, done;
+    USLOSS_Sysargs calls[NUMCALLS];
+    P2_SyscallInfo info;
+
+    Fill(calls);
+    rc = Sys_Batch(calls, NUMCALLS, FALSE, &done);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(done, NUMCALLS);
+    TEST((int) calls[0].arg1, p3Pid);
+    TEST((int) calls[1].arg1, p3Pid);
+    TEST_RC((int) calls[2].arg4, P1_NO_CHILDREN);
+    TEST_RC((int) calls[3].arg4, P1_SUCCESS);
+    TEST((int) calls[3].arg1 > 0, 1);
+    TEST_RC((int) calls[4].arg4, P2_INVALID_SYSCALL);
+
+    Fill(calls);
+    rc = Sys_Batch(calls, NUMCALLS, TRUE, &done);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(done, 3);
+    TEST((int) calls[3].arg1, 0);
+
+    rc = Sys_Batch(calls, -1, FALSE, &done);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    rc = Sys_SyscallStats(SYS_GETPID, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, 4);
+    rc = Sys_SyscallStats(SYS_BATCH, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, 3);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
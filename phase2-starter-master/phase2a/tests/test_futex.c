@@ -0,0 +1,120 @@
+/*
+ * test_futex.c
+ *
+ * Tests Sys_FutexWait and Sys_FutexWake without the clock. A wait whose expected value is stale
+ * must return at once. Waiters run at a higher priority than P3_Startup, so each has blocked on
+ * its address by the time Sys_Spawn returns. A wake must release at most max of them, the
+ * longest waiting first, and only those waiting on its address.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define WAITERS 3
+
+static int word;
+static int other;
+static int returned[WAITERS + 1];
+
+// waits on word, or on other if arg is WAITERS
+int Waiter(void *arg) {
+    int *addr = ((int) arg == WAITERS) ? &other : &word;
+    int rc;
+
+    rc = Sys_FutexWait(addr, 0);
+    TEST_RC(rc, P1_SUCCESS);
+    returned[(int) arg] = TRUE;
+    return (int) arg;
+}
+
+// waits for a child and returns its status
+static int Reap(void)
+{
+    int rc, pid, status = -1;
+
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    return status;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, first, second;
+    int woken = -1;
+
+    rc = Sys_FutexWait(NULL, 0);
+    TEST_RC(rc, P2_NULL_ADDRESS);
+    rc = Sys_FutexWake(&word, -1, &woken);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    // stale expected value, so it doesn't block
+    rc = Sys_FutexWait(&word, 1);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_FutexWake(&word, 1, &woken);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(woken, 0);
+
+    for (int i = 0; i <= WAITERS; i++) {
+        rc = Sys_Spawn("Waiter", Waiter, (void *) i, USLOSS_MIN_STACK, 2, &pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i <= WAITERS; i++) {
+        TEST(returned[i], FALSE);
+    }
+
+    rc = Sys_FutexWake(&word, 2, &woken);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(woken, 2);
+    first = Reap();
+    second = Reap();
+    TEST(first + second, 0 + 1);
+    TEST(returned[WAITERS - 1], FALSE);
+    TEST(returned[WAITERS], FALSE);
+
+    // only the last waiter on word is left
+    rc = Sys_FutexWake(&word, WAITERS, &woken);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(woken, 1);
+    TEST(Reap(), WAITERS - 1);
+    TEST(returned[WAITERS], FALSE);
+
+    rc = Sys_FutexWake(&other, 0, &woken);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(woken, 0);
+    rc = Sys_FutexWake(&other, 1, &woken);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(woken, 1);
+    TEST(Reap(), WAITERS);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,139 @@
+/*
+ * test_mbox.c
+ *
+ * Tests mailboxes. The non-blocking calls must report a full or empty mailbox, messages must
+ * arrive in the order they were sent, and the receiver must get the sender's buffer itself
+ * rather than a copy. A Consumer receives from a one-slot mailbox, so the sender blocks whenever
+ * it gets ahead.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define MESSAGES 20
+#define SIZE 1000
+
+static int p3Pid = -1;
+static char *sent[MESSAGES];    // buffers in the order they were sent
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+/*
+ * Consumer
+ *
+ * Receives MESSAGES messages from the mailbox in arg, checks them, and frees them.
+ */
+int Consumer(void *arg) {
+    int mbox = (int) arg;
+    void *buffer = NULL;
+    int rc;
+    int size = 0;
+
+    for (int i = 0; i < MESSAGES; i++) {
+        rc = Sys_MailboxReceive(mbox, &buffer, &size);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(buffer == sent[i], 1);
+        TEST(size, SIZE);
+        TEST(((char *) buffer)[SIZE - 1], (char) i);
+        free(buffer);
+    }
+    return 42;
+}
+
+int P3_Startup(void *arg) {
+    int a = 1, b = 2;
+    void *buffer = NULL;
+    int rc, pid, status;
+    int mbox = -1;
+    int size = 0;
+
+    rc = Sys_MailboxCreate(0, &mbox);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = Sys_MailboxCreate(P2_MAX_SLOTS + 1, &mbox);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    rc = Sys_MailboxCreate(2, &mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxCondReceive(mbox, &buffer, &size);
+    TEST_RC(rc, P2_WOULD_BLOCK);
+    rc = Sys_MailboxCondSend(mbox, &a, sizeof(a));
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxCondSend(mbox, &b, sizeof(b));
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxCondSend(mbox, &a, sizeof(a));
+    TEST_RC(rc, P2_WOULD_BLOCK);
+    // the same buffers come back, in order
+    rc = Sys_MailboxCondReceive(mbox, &buffer, &size);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(buffer == &a, 1);
+    TEST(size, sizeof(a));
+    rc = Sys_MailboxReceive(mbox, &buffer, &size);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(buffer == &b, 1);
+    // a mailbox holding a buffer can't be released until it is received
+    rc = Sys_MailboxCondSend(mbox, &a, sizeof(a));
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxRelease(mbox);
+    TEST_RC(rc, P2_MBOX_NOT_EMPTY);
+    rc = Sys_MailboxCondReceive(mbox, &buffer, &size);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(buffer == &a, 1);
+    rc = Sys_MailboxRelease(mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxSend(mbox, &a, sizeof(a));
+    TEST_RC(rc, P2_INVALID_MBOX);
+    rc = Sys_MailboxRelease(mbox);
+    TEST_RC(rc, P2_INVALID_MBOX);
+
+    // hand buffers to the Consumer through a single slot
+    rc = Sys_MailboxCreate(1, &mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Consumer", Consumer, (void *) mbox, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < MESSAGES; i++) {
+        sent[i] = malloc(SIZE);
+        assert(sent[i] != NULL);
+        sent[i][SIZE - 1] = (char) i;
+        rc = Sys_MailboxSend(mbox, sent[i], SIZE);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 42);
+    rc = Sys_MailboxRelease(mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,130 @@
+/*
+ * test_mboxbench.c
+ *
+ * Mailbox throughput benchmark. A Producer sends MESSAGES buffers to a Consumer, first small ones
+ * and then large ones, and the Consumer hands each buffer back through a second mailbox so the
+ * Producer can reuse it. Messages are passed by reference, so the rate should hardly depend on
+ * the size. Reports messages per second and megabytes per second for both sizes.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define MESSAGES 2000
+#define BUFFERS 8
+#define SMALL 16
+#define LARGE (64 * 1024)
+
+static int full;                // buffers going to the Consumer
+static int empty;               // buffers coming back
+
+int P2_Startup(void *arg)
+{
+    int rc, p3Pid, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+/*
+ * Consumer
+ *
+ * Receives MESSAGES buffers of arg bytes, checks each, and returns it.
+ */
+int Consumer(void *arg) {
+    int expected = (int) arg;
+    void *buffer = NULL;
+    int rc;
+    int size = 0;
+
+    for (int i = 0; i < MESSAGES; i++) {
+        rc = Sys_MailboxReceive(full, &buffer, &size);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(size, expected);
+        TEST(((char *) buffer)[0], (char) i);
+        rc = Sys_MailboxSend(empty, buffer, size);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    return 0;
+}
+
+/*
+ * Bench
+ *
+ * Sends MESSAGES buffers of size bytes to a Consumer and reports the throughput.
+ */
+static void Bench(char *label, int size) {
+    void *buffer;
+    int rc, pid, status, start, end, elapsed, length;
+
+    for (int i = 0; i < BUFFERS; i++) {
+        buffer = malloc(size);
+        assert(buffer != NULL);
+        rc = Sys_MailboxSend(empty, buffer, size);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_Spawn("Consumer", Consumer, (void *) size, USLOSS_MIN_STACK, 2, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < MESSAGES; i++) {
+        rc = Sys_MailboxReceive(empty, &buffer, &length);
+        TEST_RC(rc, P1_SUCCESS);
+        ((char *) buffer)[0] = (char) i;
+        rc = Sys_MailboxSend(full, buffer, size);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&end);
+    elapsed = end - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    USLOSS_Console("%s: %d messages of %d bytes in %d us, %lld messages/s, %lld MB/s\n",
+                   label, MESSAGES, size, elapsed, MESSAGES * 1000000LL / elapsed,
+                   (long long) MESSAGES * size / elapsed);
+    for (int i = 0; i < BUFFERS; i++) {
+        rc = Sys_MailboxReceive(empty, &buffer, &length);
+        TEST_RC(rc, P1_SUCCESS);
+        free(buffer);
+    }
+}
+
+int P3_Startup(void *arg) {
+    int rc;
+
+    rc = Sys_MailboxCreate(BUFFERS, &full);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxCreate(BUFFERS, &empty);
+    TEST_RC(rc, P1_SUCCESS);
+    Bench("small", SMALL);
+    Bench("large", LARGE);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,114 @@
+/*
+ * test_snapshot.c
+ *
+ * Tests Sys_GetProcSnapshot. The snapshot must list exactly the processes Sys_GetProcInfo reports
+ * as live, with the same information, and filtering by state must only return processes in the
+ * selected states.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define CHILDREN 3
+
+static int p3Pid = -1;
+static P2_ProcSnapshot snapshot[P1_MAXPROC];
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+int Child(void *arg) {
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P1_ProcInfo info;
+    int pids[CHILDREN];
+    int statuses[CHILDREN];
+    int rc, count, live = 0, found = 0;
+    char name[P1_MAXNAME];
+
+    // lower priority, so they stay ready
+    for (int i = 0; i < CHILDREN; i++) {
+        snprintf(name, sizeof(name), "Child%d", i);
+        rc = Sys_Spawn(name, Child, NULL, USLOSS_MIN_STACK, 3, &pids[i]);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+
+    rc = Sys_GetProcSnapshot(snapshot, P1_MAXPROC, 0, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int pid = 0; pid < P1_MAXPROC; pid++) {
+        rc = Sys_GetProcInfo(pid, &info);
+        if ((rc == P1_SUCCESS) && (info.state != P1_STATE_FREE)) {
+            TEST(live < count, 1);
+            TEST(snapshot[live].pid, pid);
+            TEST(strcmp(snapshot[live].info.name, info.name), 0);
+            TEST(snapshot[live].info.parent, info.parent);
+            live++;
+        }
+    }
+    TEST(count, live);
+
+    rc = Sys_GetProcSnapshot(snapshot, P1_MAXPROC, P2_STATE(P1_STATE_RUNNING), &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 1);
+    TEST(snapshot[0].pid, p3Pid);
+
+    rc = Sys_GetProcSnapshot(snapshot, P1_MAXPROC, 
+                             P2_STATE(P1_STATE_READY) | P2_STATE(P1_STATE_RUNNING), &count);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < count; i++) {
+        TEST((snapshot[i].info.state == P1_STATE_READY) ||
+             (snapshot[i].info.state == P1_STATE_RUNNING), 1);
+        for (int j = 0; j < CHILDREN; j++) {
+            if (snapshot[i].pid == pids[j]) {
+                found++;
+            }
+        }
+    }
+    TEST(found, CHILDREN);
+
+    rc = Sys_GetProcSnapshot(snapshot, 1, 0, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 1);
+    rc = Sys_GetProcSnapshot(snapshot, -1, 0, &count);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    rc = Sys_WaitN(CHILDREN, pids, statuses, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, CHILDREN);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,130 @@
+/*
+ * test_spawnbench.c
+ *
+ * Benchmark of P2_Spawn. Spawns and reaps short-lived processes one at a time, first with stack
+ * size classes turned off and then with them on, and reports the average time P2_Spawn takes.
+ * The stack sizes vary so that without size classes consecutive stacks are different sizes.
+ * Also checks that sizes too small for a stack are still rejected, and, through the stack
+ * statistics, that sizes are only rounded up to a class once a cap is set.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+#define SPAWNS 1000
+
+static int Now(void)
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+int Child(void *arg) {
+    return (int) arg;
+}
+
+/*
+ * Size
+ *
+ * Spawns a child with the stack size and returns the size P2_Spawn asked Phase 1 for.
+ */
+
+static int Size(int stackSize)
+{
+    P2_StackStats stats;
+    int rc, pid, waitPid, status, count;
+
+    rc = P2_SpawnSetStackMode(P2_STACK_MEASURE);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Spawn("Sized", Child, (void *) 1, stackSize, 5, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_SpawnSetStackMode(P2_STACK_FIXED);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_SpawnStackStats(&stats, 1, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 1);
+    return stats.stackSize;
+}
+
+/*
+ * Bench
+ *
+ * Spawns SPAWNS children, joining each before spawning the next, and returns the average
+ * time in microseconds spent in P2_Spawn.
+ */
+
+static int Bench(void)
+{
+    int rc, pid, waitPid, status, start;
+    int elapsed = 0;
+
+    for (int i = 0; i < SPAWNS; i++) {
+        int stackSize = USLOSS_MIN_STACK + (i % 8) * 1000;
+
+        start = Now();
+        // the child has lower priority, so it doesn't run until we wait
+        rc = P2_Spawn("Child", Child, (void *) i, stackSize, 5, &pid);
+        elapsed += Now() - start;
+        TEST_RC(rc, P1_SUCCESS);
+        rc = P2_Wait(&waitPid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(waitPid, pid);
+        TEST(status, i);
+    }
+    return elapsed / SPAWNS;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, plain, classed;
+
+    P2ProcInit();
+    rc = P2_SpawnSetStackCap(-1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_Spawn("Child", Child, NULL, USLOSS_MIN_STACK - 1, 5, &pid);
+    TEST_RC(rc, P1_INVALID_STACK);
+
+    // no size classes by default
+    TEST(Size(USLOSS_MIN_STACK + 1000), USLOSS_MIN_STACK + 1000);
+    rc = P2_SpawnSetStackCap(P2_STACK_CAP);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(Size(USLOSS_MIN_STACK + 1000), 2 * USLOSS_MIN_STACK);
+    TEST(Size(P2_STACK_CAP + 1000), P2_STACK_CAP + 1000);
+
+    rc = P2_SpawnSetStackCap(0);
+    TEST_RC(rc, P1_SUCCESS);
+    plain = Bench();
+    rc = P2_SpawnSetStackCap(P2_STACK_CAP);
+    TEST_RC(rc, P1_SUCCESS);
+    classed = Bench();
+    USLOSS_Console("P2_Spawn: %d us without size classes, %d us with\n", plain, classed);
+
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
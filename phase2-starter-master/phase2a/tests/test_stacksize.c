@@ -0,0 +1,151 @@
+/*
+ * test_stacksize.c
+ *
+ * Tests stack measurement. With measuring on, a Deep child that recurses through DEPTH frames
+ * must be recorded as using more of its stack than a Shallow one, and at least the frames'
+ * buffers. In adaptive mode a later Shallow child must get a smaller stack than it asked for,
+ * while nothing is recorded for names spawned with measuring off. An adapted size is not rounded
+ * up to a size class, and a process that calls Sys_Terminate itself is not measured.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+#define STACK (4 * USLOSS_MIN_STACK)
+#define DEPTH 16
+#define FRAME 1024
+
+int Shallow(void *arg) {
+    return 1;
+}
+
+static int Recurse(int depth)
+{
+    volatile char frame[FRAME];
+
+    memset((char *) frame, depth, sizeof(frame));
+    if (depth == 0) {
+        return frame[0];
+    }
+    return Recurse(depth - 1) + frame[FRAME - 1];
+}
+
+int Deep(void *arg) {
+    return Recurse(DEPTH) > 0;
+}
+
+// uses more than USLOSS_MIN_STACK / 1.5, so its adapted stack is above USLOSS_MIN_STACK
+int Deeper(void *arg) {
+    return Recurse(4 * DEPTH) > 0;
+}
+
+int Quitter(void *arg) {
+    Sys_Terminate(1);
+    return 0;
+}
+
+/*
+ * Run
+ *
+ * Spawns a child with the name and function and waits for it.
+ */
+
+static void Run(char *name, int (*func)(void *))
+{
+    int rc, pid, waitPid, status;
+
+    rc = P2_Spawn(name, func, NULL, STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, pid);
+    TEST(status, 1);
+}
+
+int P2_Startup(void *arg)
+{
+    P2_StackStats stats[P2_STACK_NAMES];
+    int rc, count;
+
+    P2ProcInit();
+    rc = P2_SpawnSetStackMode(P2_STACK_ADAPTIVE + 1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_SpawnStackStats(stats, -1, &count);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    // not measured
+    Run("Unmeasured", Shallow);
+
+    rc = P2_SpawnSetStackMode(P2_STACK_MEASURE);
+    TEST_RC(rc, P1_SUCCESS);
+    Run("Shallow", Shallow);
+    Run("Deep", Deep);
+    Run("Deeper", Deeper);
+    Run("Quitter", Quitter);
+    rc = P2_SpawnStackStats(stats, P2_STACK_NAMES, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 4);
+    TEST(strcmp(stats[3].name, "Quitter"), 0);
+    TEST(stats[3].spawns, 1);
+    TEST(stats[3].measured, 0);
+    count = 2;
+    TEST(strcmp(stats[0].name, "Shallow"), 0);
+    TEST(strcmp(stats[1].name, "Deep"), 0);
+    for (int i = 0; i < count; i++) {
+        TEST(stats[i].spawns, 1);
+        TEST(stats[i].measured, 1);
+        TEST(stats[i].stackSize, STACK);
+        USLOSS_Console("%s used %d bytes\n", stats[i].name, stats[i].maxUsed);
+    }
+    TEST(stats[0].maxUsed < stats[1].maxUsed, 1);
+    TEST(stats[1].maxUsed >= DEPTH * FRAME, 1);
+
+    // the next Shallow gets a stack sized from what the first one used
+    rc = P2_SpawnSetStackMode(P2_STACK_ADAPTIVE);
+    TEST_RC(rc, P1_SUCCESS);
+    Run("Shallow", Shallow);
+    rc = P2_SpawnStackStats(stats, 1, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 1);
+    TEST(stats[0].spawns, 2);
+    TEST(stats[0].measured, 2);
+    TEST(stats[0].stackSize < STACK, 1);
+    TEST(stats[0].stackSize >= USLOSS_MIN_STACK, 1);
+
+    // with size classes on, Deeper gets its adapted size rather than the class above it
+    rc = P2_SpawnSetStackCap(P2_STACK_CAP);
+    TEST_RC(rc, P1_SUCCESS);
+    Run("Deeper", Deeper);
+    rc = P2_SpawnStackStats(stats, P2_STACK_NAMES, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(strcmp(stats[2].name, "Deeper"), 0);
+    TEST(stats[2].spawns, 2);
+    TEST(stats[2].stackSize > USLOSS_MIN_STACK, 1);
+    TEST(stats[2].stackSize < 2 * USLOSS_MIN_STACK, 1);
+    TEST(stats[2].stackSize >= stats[2].maxUsed, 1);
+    rc = P2_SpawnSetStackCap(0);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_SpawnSetStackMode(P2_STACK_FIXED);
+    TEST_RC(rc, P1_SUCCESS);
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,117 @@
+/*
+ * test_syscalls.c
+ *
+ * Tests the system call table. P2_Startup installs a handler for an unused system call number;
+ * P3_Startup calls it and a few standard system calls, and checks that the per-system call
+ * counters reflect exactly those calls. Numbers outside the table are rejected.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define SYS_ECHO    (P2_MAX_SYSCALLS - 1)
+#define CALLS       5
+
+/*
+ * EchoStub
+ *
+ * Returns its first argument as the result.
+ */
+
+static void EchoStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = sysargs->arg1;
+}
+
+static int Echo(int value)
+{
+    USLOSS_Sysargs sa;
+
+    sa.number = SYS_ECHO;
+    sa.arg1 = (void *) value;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0, p3Pid = -1;
+
+    P2ProcInit();
+    rc = P2_SetSyscallHandler(0, EchoStub);
+    TEST_RC(rc, P2_INVALID_SYSCALL);
+    rc = P2_SetSyscallHandler(P2_MAX_SYSCALLS, EchoStub);
+    TEST_RC(rc, P2_INVALID_SYSCALL);
+    rc = P2_SetSyscallHandler(SYS_ECHO, EchoStub);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+    P2_SyscallInfo info;
+    USLOSS_Sysargs sa;
+
+    for (int i = 0; i < CALLS; i++) {
+        rc = Echo(i);
+        TEST(rc, i);
+        rc = Sys_GetPid(&pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    // no children, so this fails
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+
+    // beyond the table
+    sa.number = P2_MAX_SYSCALLS + 5;
+    USLOSS_Syscall(&sa);
+    TEST_RC((int) sa.arg4, P2_INVALID_SYSCALL);
+
+    rc = Sys_SyscallStats(SYS_ECHO, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, CALLS);
+    // none of the results was negative
+    TEST(info.errors, 0);
+    TEST(info.maxTime <= info.time, 1);
+
+    rc = Sys_SyscallStats(SYS_GETPID, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, CALLS);
+
+    rc = Sys_SyscallStats(SYS_WAIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, 1);
+    TEST(info.errors, 1);
+
+    rc = Sys_SyscallStats(P2_MAX_SYSCALLS, &info);
+    TEST_RC(rc, P2_INVALID_SYSCALL);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,105 @@
+/*
+ * test_trace.c
+ *
+ * Tests the system call tracer. Only the calls made while it is on are recorded, with their
+ * arguments and results, and when more calls are made than the trace holds the oldest records
+ * are the ones lost.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define EXTRA 10
+
+static int p3Pid = -1;
+static P2_TraceRecord records[P2_TRACE_RECORDS];
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status, count;
+
+    // not traced
+    rc = Sys_GetPid(&pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = Sys_TraceControl(TRUE);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_GetPid(&pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+    rc = Sys_TraceControl(FALSE);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_GetPid(&pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = Sys_TraceRead(records, P2_TRACE_RECORDS, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 3);
+    for (int i = 0; i < count; i++) {
+        TEST(records[i].seq, i);
+        TEST(records[i].pid, p3Pid);
+        TEST(records[i].entry <= records[i].exit, 1);
+    }
+    TEST(records[0].number, SYS_GETPID);
+    TEST_RC(records[0].rc, P1_SUCCESS);
+    TEST(records[1].number, SYS_WAIT);
+    TEST_RC(records[1].rc, P1_NO_CHILDREN);
+    TEST(records[2].number, SYS_TRACECONTROL);
+    TEST(records[2].args[0], FALSE);
+
+    // nothing left
+    rc = Sys_TraceRead(records, P2_TRACE_RECORDS, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 0);
+
+    // overflow the trace, the first EXTRA + 1 of these are lost
+    rc = Sys_TraceControl(TRUE);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < P2_TRACE_RECORDS + EXTRA; i++) {
+        rc = Sys_GetPid(&pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_TraceControl(FALSE);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_TraceRead(records, P2_TRACE_RECORDS, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, P2_TRACE_RECORDS);
+    TEST(records[0].seq, 3 + EXTRA + 1);
+    TEST(records[count - 1].number, SYS_TRACECONTROL);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
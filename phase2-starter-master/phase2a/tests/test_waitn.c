@@ -0,0 +1,108 @@
+/*
+ * test_waitn.c
+ *
+ * Tests Sys_SpawnMany and Sys_WaitN. P3_Startup spawns its children with one system call, waits
+ * for some of them and then for the rest, and checks that each child was waited for exactly once
+ * with its own status. A batch that contains a bad entry stops there.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define CHILDREN 5
+#define FIRST 3
+
+static int p3Pid = -1;
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    PASSED();
+    return 0;
+}
+
+int Child(void *arg) {
+    return (int) arg;
+}
+
+int P3_Startup(void *arg) {
+    P2_SpawnEntry entries[CHILDREN];
+    char names[CHILDREN][P1_MAXNAME];
+    int pids[CHILDREN];
+    int waitPids[CHILDREN];
+    int statuses[CHILDREN];
+    int seen[CHILDREN];
+    int rc, spawned, count;
+
+    for (int i = 0; i < CHILDREN; i++) {
+        snprintf(names[i], sizeof(names[i]), "Child%d", i);
+        entries[i].name = names[i];
+        entries[i].func = Child;
+        entries[i].arg = (void *) i;
+        entries[i].stackSize = USLOSS_MIN_STACK;
+        // lower priority, so none of them run until we wait
+        entries[i].priority = 3;
+        seen[i] = FALSE;
+    }
+    rc = Sys_SpawnMany(entries, CHILDREN, pids, &spawned);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(spawned, CHILDREN);
+
+    rc = Sys_WaitN(FIRST, waitPids, statuses, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, FIRST);
+    // asks for more than are left
+    rc = Sys_WaitN(CHILDREN, waitPids + FIRST, statuses + FIRST, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, CHILDREN - FIRST);
+    for (int i = 0; i < CHILDREN; i++) {
+        int child = statuses[i];
+        TEST(child >= 0 && child < CHILDREN, 1);
+        TEST(seen[child], FALSE);
+        TEST(waitPids[i], pids[child]);
+        seen[child] = TRUE;
+    }
+    rc = Sys_WaitN(1, waitPids, statuses, &count);
+    TEST_RC(rc, P1_NO_CHILDREN);
+    rc = Sys_WaitN(0, waitPids, statuses, &count);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    // the third entry is bad, the first two are spawned
+    entries[2].func = NULL;
+    rc = Sys_SpawnMany(entries, CHILDREN, pids, &spawned);
+    TEST_RC(rc, P2_NULL_ADDRESS);
+    TEST(spawned, 2);
+    rc = Sys_WaitN(CHILDREN, waitPids, statuses, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 2);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
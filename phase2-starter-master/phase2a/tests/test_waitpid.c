@@ -0,0 +1,162 @@
+/*
+ * test_waitpid.c
+ *
+ * Tests Sys_WaitPid and Sys_WaitNoHang. P3_Startup waits for its last child first; the children
+ * that exited before it must then be returned in the order they exited, without waiting, and
+ * Sys_Wait must still return the children Sys_WaitPid skipped. P2_WaitPid must refuse a child
+ * created by P1_Fork rather than wait for it, and a child whose parent terminated without waiting
+ * for it must quit when it terminates instead of waiting to be reaped.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define CHILDREN 3
+
+static int p3Pid = -1;
+static int orphanPid = -1;
+
+int Forked(void *arg) {
+    return 3;
+}
+
+int Child(void *arg);
+
+// returns without waiting for its child, which runs after it has terminated
+int Parent(void *arg) {
+    int rc;
+
+    rc = Sys_Spawn("Orphan", Child, (void *) 7, USLOSS_MIN_STACK, 4, &orphanPid);
+    TEST_RC(rc, P1_SUCCESS);
+    return 5;
+}
+
+int P2_Startup(void *arg)
+{
+    P1_ProcInfo info;
+    int rc, pid = -1, waitPid = 0, status = 0;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    rc = P1_Fork("Forked", Forked, NULL, USLOSS_MIN_STACK, 5, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_WaitPid(pid, &status);
+    TEST_RC(rc, P2_NOT_SPAWNED);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, pid);
+    TEST(status, 3);
+
+    rc = P2_Spawn("Parent", Parent, NULL, USLOSS_MIN_STACK, 1, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, pid);
+    TEST(status, 5);
+    // the orphan runs before Last
+    rc = P2_Spawn("Last", Child, (void *) 0, USLOSS_MIN_STACK, 5, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_WaitPid(pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_GetProcInfo(orphanPid, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST((info.state == P1_STATE_QUIT) || (info.state == P1_STATE_FREE), 1);
+
+    PASSED();
+    return 0;
+}
+
+int Child(void *arg) {
+    return (int) arg;
+}
+
+/*
+ * SpawnChildren
+ *
+ * Spawns CHILDREN children at a lower priority, so they run in order once the caller blocks.
+ */
+static void SpawnChildren(char *prefix, int *pids)
+{
+    char name[P1_MAXNAME];
+    int rc;
+
+    for (int i = 0; i < CHILDREN; i++) {
+        snprintf(name, sizeof(name), "%s%d", prefix, i);
+        rc = Sys_Spawn(name, Child, (void *) i, USLOSS_MIN_STACK, 3, &pids[i]);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+}
+
+int P3_Startup(void *arg) {
+    int pids[CHILDREN];
+    int rc, pid, status;
+
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+
+    SpawnChildren("First", pids);
+    // none of them has run yet
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(pid, -1);
+    rc = Sys_WaitPid(p3Pid, &status);
+    TEST_RC(rc, P1_INVALID_PID);
+    rc = Sys_WaitPid(-1, &status);
+    TEST_RC(rc, P1_INVALID_PID);
+
+    // the others exit while we wait for the last one
+    rc = Sys_WaitPid(pids[CHILDREN - 1], &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, CHILDREN - 1);
+    for (int i = 0; i < CHILDREN - 1; i++) {
+        rc = Sys_WaitNoHang(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(pid, pids[i]);
+        TEST(status, i);
+    }
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+
+    // Sys_Wait returns the ones Sys_WaitPid passed over
+    SpawnChildren("Second", pids);
+    rc = Sys_WaitPid(pids[1], &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 1);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(pid, pids[0]);
+    TEST(status, 0);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(pid, pids[2]);
+    TEST(status, 2);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+    return 11;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+}
+
+void finish(int argc, char **argv) {}
@@ -7,12 +7,539 @@
 #include <phase1.h>
 
 #include "phase2Int.h"
+#include "phase2ExtInt.h"
 
 
 static int      ClockDriver(void *);
 static void     SleepStub(USLOSS_Sysargs *sysargs);
+static void     SleepMsStub(USLOSS_Sysargs *sysargs);
+static void     SleepUntilStub(USLOSS_Sysargs *sysargs);
+static void     TimerExit(int pid);
+static void     WaitExit(int pid);
+static void     WaitTimedStub(USLOSS_Sysargs *sysargs);
+static void     ClockStatsStub(USLOSS_Sysargs *sysargs);
+static void     ProfileStub(USLOSS_Sysargs *sysargs);
+static void     TimePageStub(USLOSS_Sysargs *sysargs);
+static void     TimerCreateStub(USLOSS_Sysargs *sysargs);
+static void     TimerWaitStub(USLOSS_Sysargs *sysargs);
+static void     TimerDeleteStub(USLOSS_Sysargs *sysargs);
+static int      TimerReady(int timerId);
 
-static int      now; // current time
+/*
+ * Sleepers are kept in a hierarchical timing wheel. Time is measured in ticks of TICK
+ * microseconds, the clock interrupt period. Level 0 has one slot per tick for the next SLOTS
+ * ticks; each slot of level n covers SLOTS times as many ticks as a slot of level n-1. A timer is
+ * put in the lowest level whose range covers its expiry, so inserting is O(1).
+ * Whenever level 0 wraps around, the current slot of level 1 is cascaded, i.e. its timers are
+ * re-inserted into level 0, and so on up the levels. The driver therefore only touches timers
+ * that are due, plus each timer once per level on its way down.
+ *
+ * Sleepers due at the same tick are woken together: a sleeper waits on the condition variable of
+ * its expiry tick's level 0 slot and its priority, and the driver broadcasts each such condition
+ * once per tick instead of signaling every sleeper. Phase 1 only lets the holder of a condition's
+ * lock broadcast it, so the driver does so with the lock held; each woken sleeper must then
+ * reacquire the lock before it returns, and Phase 1 hands the lock over in the order the waiters
+ * were woken. The driver therefore broadcasts from the highest priority to the lowest, so
+ * sleepers due at the same tick return in priority order.
+ *
+ * Periodic timers (P2_TimerCreate) live in the same wheel. When one fires the driver counts the
+ * expiration, wakes its waiters and re-inserts it one period later, so a periodic activity costs
+ * its process nothing between the times it waits.
+ *
+ * Each process also has an alarm (P2TimeoutStart) that bounds how long it waits for something
+ * else. When an alarm fires the driver calls its expire function after releasing the lock, so
+ * the function may take the lock of the subsystem the process is waiting in.
+ */
+
+#define TICK            (USLOSS_CLOCK_MS * 1000)   // microseconds per clock tick
+#define LEVEL_BITS      6
+#define SLOTS           (1 << LEVEL_BITS)   // slots per level
+#define LEVELS          4
+#define MAX_DELTA       ((1 << (LEVEL_BITS * LEVELS)) - 1) // farthest tick the wheel can hold
+#define PRIORITIES      6                   // Phase 1 priorities, 1 is the highest
+
+typedef struct Timer Timer;
+
+struct Timer {
+    int     expires;            // tick at which the timer fires
+    int     pid;                // process waiting for the timer
+    int     fired;              // TRUE once the timer has fired
+    int     period;             // ticks between expirations, 0 if the timer is one-shot
+    int     priority;           // of the sleeping process, for sleep timers
+    int     expirations;        // expirations not yet collected by P2_TimerWait
+    int     id;                 // index in periodics, for periodic timers
+    int     cond;               // condition variable signaled when the timer fires
+    void    (*expire)(int pid); // called by the driver instead of signaling, for alarms
+    Timer   *next;              // links in the wheel slot
+    Timer   *prev;
+    Timer   **slot;             // slot the timer is in, NULL if not in the wheel
+};
+
+static Timer    *wheel[LEVELS][SLOTS];
+static int      wheelTick;      // next tick the driver will process
+static Timer    sleepers[P1_MAXPROC]; // one sleep timer per process
+static int      conds[P1_MAXPROC]; // condition variable each process waits on in P2_WaitTimed
+static int      tickConds[SLOTS][PRIORITIES]; // sleepers due at tick t with priority p wait on
+                                // tickConds[t % SLOTS][p - 1]
+static unsigned long long due[PRIORITIES]; // bit i of due[p] set if tickConds[i][p] must be
+                                // broadcast
+static int      lock;           // protects the wheel and the timers
+static Timer    alarms[P1_MAXPROC]; // one timeout per process
+static Timer    *expired;       // alarms that fired and whose expire function hasn't been called
+static int      delivering;     // pid whose expire function the driver is calling, -1 if none
+static int      delivered;      // signaled when the driver returns from an expire function
+static int      waiting[P1_MAXPROC]; // TRUE while the process is in P2_WaitTimed
+static int      timedOut[P1_MAXPROC]; // TRUE once the P2_WaitTimed alarm of the process fired
+static P2_ClockInfo stats;
+static int      woken;          // wakeups during the current interrupt
+
+/*
+ * The profiler samples every profileEvery-th clock interrupt. By the time the clock driver runs
+ * the interrupted process is no longer current, so the samples are taken by ProfileHandler, which
+ * is installed in front of Phase 1's clock interrupt handler and runs on the interrupted process.
+ * Samples are indexed by pid, so those of a process whose pid was reused are added together.
+ * The profiler is off until P2_ProfileSetRate turns it on, and P2ClockShutdown writes the
+ * samples only if it was.
+ */
+
+static void     (*clockHandler)(int type, void *arg); // Phase 1's clock interrupt handler
+static int      profileEvery;   // interrupts between samples, 0 if the profiler is off
+static int      profileTicks;   // interrupts since the last sample
+static int      profiled;       // TRUE once the profiler has been turned on
+static P2_ProfileSample profile[P1_MAXPROC]; // samples by pid
+
+static P2_TimePage timePage;    // shared with user code, see P2_TimePageGet
+
+typedef struct Periodic {
+    int     inUse;              // TRUE if the slot holds a timer
+    int     deleted;            // TRUE once deleted, the slot is free when the last waiter leaves
+    int     owner;              // process that created the timer
+    int     waiters;            // processes in P2_TimerWait
+    Timer   timer;
+} Periodic;
+
+static Periodic periodics[P2_MAX_TIMERS];
+static int      clockPid;
+
+/*
+ * CurrentTime
+ *
+ * Returns the current time in microseconds from the clock device.
+ */
+static int 
+CurrentTime(void)
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+/*
+ * CurrentTick
+ *
+ * Returns the tick containing the current time.
+ */
+static int 
+CurrentTick(void)
+{
+    return CurrentTime() / TICK;
+}
+
+/*
+ * TimerInsert
+ *
+ * Puts a timer in the wheel slot that covers its expiry. Called with the lock held.
+ */
+static void 
+TimerInsert(Timer *timer)
+{
+    int expires = timer->expires;
+    int delta;
+    int level;
+    Timer **slot;
+
+    if (expires < wheelTick) {
+        // already due, fire on the next tick processed
+        expires = wheelTick;
+    }
+    delta = expires - wheelTick;
+    if (delta > MAX_DELTA) {
+        // parked in the farthest slot and re-inserted when it cascades
+        expires = wheelTick + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+    for (level = 0; level < LEVELS - 1; level++) {
+        if (delta < (1 << (LEVEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+    slot = &wheel[level][(expires >> (LEVEL_BITS * level)) & (SLOTS - 1)];
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+}
+
+/*
+ * TimerRemove
+ *
+ * Takes a timer out of the wheel, if it is in it. Called with the lock held.
+ */
+static void 
+TimerRemove(Timer *timer)
+{
+    if (timer->slot == NULL) {
+        return;
+    }
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    timer->slot = NULL;
+    timer->next = timer->prev = NULL;
+}
+
+/*
+ * Cascade
+ *
+ * Re-inserts the timers in the current slot of a level so they move to lower levels. Called
+ * with the lock held.
+ */
+static void 
+Cascade(int level)
+{
+    int index = (wheelTick >> (LEVEL_BITS * level)) & (SLOTS - 1);
+    Timer *timer = wheel[level][index];
+
+    wheel[level][index] = NULL;
+    while (timer != NULL) {
+        Timer *next = timer->next;
+        timer->slot = NULL;
+        TimerInsert(timer);
+        timer = next;
+    }
+}
+
+/*
+ * Fire
+ *
+ * Wakes the processes waiting for an expired timer. Tick is the one the driver is at, so the
+ * timer is tick - expires ticks late. Called with the lock held.
+ */
+static void 
+Fire(Timer *timer, int tick)
+{
+    int rc;
+    int late = tick - timer->expires;
+
+    timer->fired = TRUE;
+    stats.wakeups++;
+    stats.lateness[(late < P2_CLOCK_LATENESS - 1) ? late : P2_CLOCK_LATENESS - 1]++;
+    woken++;
+    if (timer->expire != NULL) {
+        timer->next = expired;
+        expired = timer;
+        return;
+    }
+    if (timer->period == 0) {
+        // a sleeper, woken with the others due at the same tick
+        due[timer->priority - 1] |= 1ULL << (timer->expires & (SLOTS - 1));
+        return;
+    }
+    timer->expirations++;
+    rc = P1_Broadcast(timer->cond);
+    assert(rc == P1_SUCCESS);
+    P2EventNotify(P2_EVENT_TIMER, timer->id);
+}
+
+/*
+ * Advance
+ *
+ * Processes every tick up to and including tick, cascading higher levels as level 0 wraps and
+ * firing the timers in each level 0 slot. Called with the lock held.
+ */
+static void 
+Advance(int tick)
+{
+    while (wheelTick <= tick) {
+        int index = wheelTick & (SLOTS - 1);
+        Timer *timer;
+
+        for (int level = 1; level < LEVELS; level++) {
+            if (((wheelTick >> (LEVEL_BITS * (level - 1))) & (SLOTS - 1)) != 0) {
+                break;
+            }
+            Cascade(level);
+        }
+        timer = wheel[0][index];
+        wheel[0][index] = NULL;
+        while (timer != NULL) {
+            Timer *next = timer->next;
+            timer->slot = NULL;
+            timer->next = timer->prev = NULL;
+            if (timer->expires > wheelTick) {
+                // was parked beyond the wheel's range
+                TimerInsert(timer);
+            } else {
+                Fire(timer, tick);
+                if (timer->period > 0) {
+                    // re-arm, a driver that fell behind fires once per missed period
+                    timer->expires += timer->period;
+                    TimerInsert(timer);
+                }
+            }
+            timer = next;
+        }
+        // wake this tick's sleepers, highest priority first
+        for (int p = 0; p < PRIORITIES; p++) {
+            for (int i = 0; due[p] != 0; i++) {
+                if (due[p] & (1ULL << i)) {
+                    int rc = P1_Broadcast(tickConds[i][p]);
+                    assert(rc == P1_SUCCESS);
+                    due[p] &= ~(1ULL << i);
+                }
+            }
+        }
+        wheelTick++;
+    }
+}
+
+/*
+ * TimerFree
+ *
+ * Deletes a periodic timer. Its waiters return P2_INVALID_TIMER, the last one to leave frees the
+ * slot. Called with the lock held.
+ */
+static void 
+TimerFree(Periodic *periodic)
+{
+    int rc;
+
+    TimerRemove(&periodic->timer);
+    periodic->deleted = TRUE;
+    P2EventNotify(P2_EVENT_TIMER, periodic - periodics);
+    if (periodic->waiters == 0) {
+        periodic->inUse = FALSE;
+    } else {
+        rc = P1_Broadcast(periodic->timer.cond);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+/*
+ * TimerExit
+ *
+ * Exit hook that deletes the periodic timers of a terminating process.
+ */
+static void 
+TimerExit(int pid)
+{
+    int rc;
+
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < P2_MAX_TIMERS; i++) {
+        Periodic *periodic = &periodics[i];
+        if (periodic->inUse && !periodic->deleted && periodic->owner == pid) {
+            TimerFree(periodic);
+        }
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * P2TimeoutStart
+ *
+ * Arms the calling process's alarm so that the clock driver calls expire with its pid once ms
+ * milliseconds have passed, unless P2TimeoutCancel is called first. The caller must not hold a
+ * lock that expire takes when it calls P2TimeoutCancel.
+ */
+void 
+P2TimeoutStart(int ms, void (*expire)(int pid))
+{
+    Timer *alarm = &alarms[P1_GetPid()];
+    int rc;
+
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    assert(alarm->slot == NULL);
+    alarm->expires = (int) ((CurrentTime() + ms * 1000LL + TICK - 1) / TICK);
+    alarm->expire = expire;
+    alarm->fired = FALSE;
+    TimerInsert(alarm);
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * P2TimeoutCancel
+ *
+ * Disarms the calling process's alarm. On return its expire function is not running and won't
+ * be called.
+ */
+void 
+P2TimeoutCancel(void)
+{
+    int pid = P1_GetPid();
+    Timer *alarm = &alarms[pid];
+    int rc;
+
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    TimerRemove(alarm);
+    for (Timer **link = &expired; *link != NULL; link = &(*link)->next) {
+        if (*link == alarm) {
+            *link = alarm->next;
+            alarm->next = NULL;
+            break;
+        }
+    }
+    while (delivering == pid) {
+        rc = P1_Wait(delivered);
+        assert(rc == P1_SUCCESS);
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * WaitExit
+ *
+ * Exit hook that wakes the parent of a terminating process if it is in P2_WaitTimed.
+ */
+static void 
+WaitExit(int pid)
+{
+    P1_ProcInfo info;
+    int rc;
+
+    rc = P1_GetProcInfo(pid, &info);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    if ((info.parent >= 0) && waiting[info.parent]) {
+        rc = P1_Broadcast(conds[info.parent]);
+        assert(rc == P1_SUCCESS);
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * WaitExpire
+ *
+ * Alarm expire function for P2_WaitTimed.
+ */
+static void 
+WaitExpire(int pid)
+{
+    int rc;
+
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    timedOut[pid] = TRUE;
+    rc = P1_Broadcast(conds[pid]);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * ChildQuitting
+ *
+ * Returns TRUE if a child of the process has quit or is about to, FALSE if none has, and
+ * P1_NO_CHILDREN if it has no children.
+ */
+static int 
+ChildQuitting(int pid)
+{
+    P1_ProcInfo info;
+    P1_ProcInfo child;
+    int rc;
+
+    rc = P1_GetProcInfo(pid, &info);
+    assert(rc == P1_SUCCESS);
+    if (info.numChildren == 0) {
+        return P1_NO_CHILDREN;
+    }
+    for (int i = 0; i < info.numChildren; i++) {
+        rc = P1_GetProcInfo(info.children[i], &child);
+        assert(rc == P1_SUCCESS);
+        if ((child.state == P1_STATE_QUIT) || P2ProcExiting(info.children[i])) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * ProfileHandler
+ *
+ * Clock interrupt handler that samples the interrupted process, then passes the interrupt on.
+ */
+static void 
+ProfileHandler(int type, void *arg)
+{
+    if ((profileEvery > 0) && (++profileTicks >= profileEvery)) {
+        int pid = P1_GetPid();
+        profileTicks = 0;
+        if ((pid >= 0) && (pid < P1_MAXPROC)) {
+            // the interrupt moved the interrupted mode into the previous mode bit
+            if (USLOSS_PsrGet() & USLOSS_PSR_PREV_MODE) {
+                profile[pid].kernel++;
+            } else {
+                profile[pid].user++;
+            }
+        }
+    }
+    clockHandler(type, arg);
+}
+
+/*
+ * DumpProfile
+ *
+ * Writes the profiler's samples to path as CSV.
+ */
+static void 
+DumpProfile(char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL) {
+        USLOSS_Console("Unable to write clock profile to %s.\n", path);
+        return;
+    }
+    fprintf(f, "pid,kernel,user\n");
+    for (int pid = 0; pid < P1_MAXPROC; pid++) {
+        if (profile[pid].kernel || profile[pid].user) {
+            fprintf(f, "%d,%d,%d\n", pid, profile[pid].kernel, profile[pid].user);
+        }
+    }
+    fclose(f);
+}
+
+/*
+ * TimePageUpdate
+ *
+ * Publishes the time of a clock interrupt in the time page.
+ */
+static void 
+TimePageUpdate(int time)
+{
+    timePage.seq++;
+    timePage.now = time;
+    timePage.ticks++;
+    timePage.seq++;
+}
 
 /*
  * P2ClockInit
@@ -27,11 +554,84 @@ P2ClockInit(void)
     P2ProcInit();
 
     // initialize data structures here
+    rc = P1_LockCreate("Clock Lock", &lock);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        char name[P1_MAXNAME];
+        snprintf(name, sizeof(name), "Waiter %d", i);
+        rc = P1_CondCreate(name, lock, &conds[i]);
+        assert(rc == P1_SUCCESS);
+        sleepers[i].slot = NULL;
+        sleepers[i].period = 0;
+        sleepers[i].expire = NULL;
+        alarms[i].slot = NULL;
+        alarms[i].period = 0;
+        alarms[i].pid = i;
+        alarms[i].fired = FALSE;
+        waiting[i] = FALSE;
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        for (int p = 0; p < PRIORITIES; p++) {
+            char name[P1_MAXNAME];
+            snprintf(name, sizeof(name), "Sleepers %d/%d", i, p + 1);
+            rc = P1_CondCreate(name, lock, &tickConds[i][p]);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+    memset(due, 0, sizeof(due));
+    rc = P1_CondCreate("Alarm Delivered", lock, &delivered);
+    assert(rc == P1_SUCCESS);
+    expired = NULL;
+    delivering = -1;
+    memset(&stats, 0, sizeof(stats));
+    memset(profile, 0, sizeof(profile));
+    profileEvery = 0;
+    profileTicks = 0;
+    profiled = FALSE;
+    clockHandler = USLOSS_IntVec[USLOSS_CLOCK_INT];
+    USLOSS_IntVec[USLOSS_CLOCK_INT] = ProfileHandler;
+    for (int i = 0; i < P2_MAX_TIMERS; i++) {
+        char name[P1_MAXNAME];
+        snprintf(name, sizeof(name), "Timer %d", i);
+        rc = P1_CondCreate(name, lock, &periodics[i].timer.cond);
+        assert(rc == P1_SUCCESS);
+        periodics[i].inUse = FALSE;
+        periodics[i].timer.slot = NULL;
+        periodics[i].timer.expire = NULL;
+    }
+    memset(wheel, 0, sizeof(wheel));
+    timePage.seq = 0;
+    timePage.ticks = 0;
+    timePage.now = CurrentTime();
+    wheelTick = timePage.now / TICK;
 
     rc = P2_SetSyscallHandler(SYS_SLEEP, SleepStub);
     assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SLEEPMS, SleepMsStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SLEEPUNTIL, SleepUntilStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TIMERCREATE, TimerCreateStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TIMERWAIT, TimerWaitStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TIMERDELETE, TimerDeleteStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITTIMED, WaitTimedStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_CLOCKSTATS, ClockStatsStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_PROFILE, ProfileStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_TIMEPAGE, TimePageStub);
+    assert(rc == P1_SUCCESS);
+    P2AddExitHook(TimerExit);
+    P2AddExitHook(WaitExit);
+    P2AddEventSource(P2_EVENT_TIMER, TimerReady);
 
     // fork the clock driver here
+    rc = P1_Fork("Clock Driver", ClockDriver, NULL, USLOSS_MIN_STACK*4, 1, &clockPid);
+    assert(rc == P1_SUCCESS);
 }
 
 /*
@@ -44,6 +644,11 @@ void
 P2ClockShutdown(void) 
 {
     // stop clock driver
+    if (P1_DeviceAbort(USLOSS_CLOCK_DEV, 0));
+    USLOSS_IntVec[USLOSS_CLOCK_INT] = clockHandler;
+    if (profiled) {
+        DumpProfile(P2_PROFILE_FILE);
+    }
 }
 
 /*
@@ -57,6 +662,9 @@ ClockDriver(void *arg)
 
     while(1) {
         int rc;
+        int now;
+        int start;
+        int end;
 
         // wait for the next interrupt
         rc = P1_DeviceWait(USLOSS_CLOCK_DEV, 0, &now);
@@ -64,9 +672,83 @@ ClockDriver(void *arg)
             break;
         }
         assert(rc == P1_SUCCESS);
+        TimePageUpdate(now);
 
         // wakeup any sleeping processes whose wakeup time has arrived
+        rc = P1_Lock(lock);
+        assert(rc == P1_SUCCESS);
+        rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &start);
+        assert(rc == USLOSS_DEV_OK);
+        woken = 0;
+        Advance(now / TICK);
+        // call the expire functions of the alarms that fired
+        while (expired != NULL) {
+            Timer *alarm = expired;
+            expired = alarm->next;
+            alarm->next = NULL;
+            delivering = alarm->pid;
+            rc = P1_Unlock(lock);
+            assert(rc == P1_SUCCESS);
+            alarm->expire(alarm->pid);
+            rc = P1_Lock(lock);
+            assert(rc == P1_SUCCESS);
+            delivering = -1;
+            rc = P1_Broadcast(delivered);
+            assert(rc == P1_SUCCESS);
+        }
+        rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &end);
+        assert(rc == USLOSS_DEV_OK);
+        stats.ticks++;
+        stats.handlerTime += end - start;
+        if (end - start > stats.maxHandlerTime) {
+            stats.maxHandlerTime = end - start;
+        }
+        if (woken > stats.maxWoken) {
+            stats.maxWoken = woken;
+        }
+        rc = P1_Unlock(lock);
+        assert(rc == P1_SUCCESS);
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * SleepUntil
+ *
+ * Causes the current process to sleep until the specified time, in microseconds. The process
+ * wakes on the first clock tick at or after that time.
+ */
+static int 
+SleepUntil(long long usec)
+{
+    int pid = P1_GetPid();
+    Timer *timer = &sleepers[pid];
+    P1_ProcInfo info;
+    int start;
+    int rc;
+
+    rc = P1_GetProcInfo(pid, &info);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    start = CurrentTime();
+    if (usec > start) {
+        timer->expires = (int) ((usec + TICK - 1) / TICK);
+        timer->pid = pid;
+        timer->fired = FALSE;
+        timer->priority = info.priority;
+        timer->cond = tickConds[timer->expires & (SLOTS - 1)][info.priority - 1];
+        // add current process to data structure of sleepers
+        TimerInsert(timer);
+        // wait until it's wakeup time
+        while (!timer->fired) {
+            rc = P1_Wait(timer->cond);
+            assert(rc == P1_SUCCESS);
+        }
+        P2ProcAccount(pid)->sleepTime += CurrentTime() - start;
     }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
     return P1_SUCCESS;
 }
 
@@ -78,12 +760,308 @@ ClockDriver(void *arg)
 int 
 P2_Sleep(int seconds) 
 {
-    // update current time and determine wakeup time
-    // add current process to data structure of sleepers
-    // wait until it's wakeup time
+    if (seconds < 0) {
+        return P2_INVALID_SECONDS;
+    }
+    // determine wakeup time from the current time
+    return SleepUntil(CurrentTime() + seconds * 1000000LL);
+}
+
+/*
+ * P2_SleepMs
+ *
+ * Causes the current process to sleep for the specified number of milliseconds.
+ */
+int 
+P2_SleepMs(int ms)
+{
+    if (ms < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    return SleepUntil(CurrentTime() + ms * 1000LL);
+}
+
+/*
+ * P2_SleepUntil
+ *
+ * Causes the current process to sleep until the specified USLOSS time, in microseconds. A time
+ * that has already passed returns at once, so periodic loops that advance their deadline by a
+ * fixed period don't drift.
+ */
+int 
+P2_SleepUntil(int usec)
+{
+    return SleepUntil(usec);
+}
+
+/*
+ * P2_TimerCreate
+ *
+ * Creates a timer that expires every periodMs milliseconds, starting one period from now, and
+ * returns its id in *timerId. The timer is deleted when the process that created it terminates.
+ */
+int 
+P2_TimerCreate(int periodMs, int *timerId)
+{
+    int rc;
+    int result = P2_INVALID_TIMER;
+
+    if (timerId == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (periodMs <= 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < P2_MAX_TIMERS; i++) {
+        Periodic *periodic = &periodics[i];
+        if (!periodic->inUse) {
+            Timer *timer = &periodic->timer;
+            periodic->inUse = TRUE;
+            periodic->deleted = FALSE;
+            periodic->owner = P1_GetPid();
+            periodic->waiters = 0;
+            timer->period = (int) ((periodMs * 1000LL + TICK - 1) / TICK);
+            timer->expires = CurrentTick() + timer->period;
+            timer->pid = periodic->owner;
+            timer->fired = FALSE;
+            timer->expirations = 0;
+            timer->id = i;
+            TimerInsert(timer);
+            *timerId = i;
+            result = P1_SUCCESS;
+            break;
+        }
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * P2_TimerWait
+ *
+ * Waits until the timer has expired at least once since the last call, and returns in
+ * *expirations how many times it has. A value greater than one means periods were missed.
+ */
+int 
+P2_TimerWait(int timerId, int *expirations)
+{
+    Periodic *periodic;
+    int rc;
+    int result = P1_SUCCESS;
+
+    if (expirations == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (timerId < 0 || timerId >= P2_MAX_TIMERS) {
+        return P2_INVALID_TIMER;
+    }
+    periodic = &periodics[timerId];
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    if (!periodic->inUse || periodic->deleted) {
+        result = P2_INVALID_TIMER;
+    } else {
+        periodic->waiters++;
+        while (!periodic->deleted && periodic->timer.expirations == 0) {
+            rc = P1_Wait(periodic->timer.cond);
+            assert(rc == P1_SUCCESS);
+        }
+        periodic->waiters--;
+        if (periodic->deleted) {
+            if (periodic->waiters == 0) {
+                periodic->inUse = FALSE;
+            }
+            result = P2_INVALID_TIMER;
+        } else {
+            *expirations = periodic->timer.expirations;
+            periodic->timer.expirations = 0;
+        }
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * TimerReady
+ *
+ * Event source for P2_EVENT_TIMER. The timer has expired since the last P2_TimerWait, so the
+ * next one returns at once.
+ */
+static int 
+TimerReady(int timerId)
+{
+    Periodic *periodic;
+    int rc;
+    int ready;
+
+    if (timerId < 0 || timerId >= P2_MAX_TIMERS) {
+        return TRUE;
+    }
+    periodic = &periodics[timerId];
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    ready = !periodic->inUse || periodic->deleted || (periodic->timer.expirations > 0);
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    return ready;
+}
+
+/*
+ * P2_TimerDelete
+ *
+ * Deletes a timer. Processes waiting for it return P2_INVALID_TIMER.
+ */
+int 
+P2_TimerDelete(int timerId)
+{
+    Periodic *periodic;
+    int rc;
+    int result = P1_SUCCESS;
+
+    if (timerId < 0 || timerId >= P2_MAX_TIMERS) {
+        return P2_INVALID_TIMER;
+    }
+    periodic = &periodics[timerId];
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    if (!periodic->inUse || periodic->deleted) {
+        result = P2_INVALID_TIMER;
+    } else {
+        TimerFree(periodic);
+    }
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * P2_WaitTimed
+ *
+ * Like P2_Wait, but returns P2_TIMEOUT if no child has quit within timeoutMs milliseconds.
+ * While the process has children created by P2_Spawn only they end the wait, as P2_Wait would
+ * not return any other child before them; a kernel child that quits ends it only once they are
+ * all gone.
+ */
+int 
+P2_WaitTimed(int timeoutMs, int *pid, int *status)
+{
+    int me = P1_GetPid();
+    int rc;
+    int result;
+
+    if (pid == NULL || status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (timeoutMs < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    timedOut[me] = FALSE;
+    P2TimeoutStart(timeoutMs, WaitExpire);
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    waiting[me] = TRUE;
+    while (1) {
+        result = P2ProcWaitReady(me);
+        if (result == P1_NO_CHILDREN) {
+            // P2_Wait joins the others, which doesn't block if one has quit
+            result = ChildQuitting(me);
+        }
+        if ((result != FALSE) || timedOut[me]) {
+            break;
+        }
+        rc = P1_Wait(conds[me]);
+        assert(rc == P1_SUCCESS);
+    }
+    waiting[me] = FALSE;
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    P2TimeoutCancel();
+    if (result == P1_NO_CHILDREN) {
+        return P1_NO_CHILDREN;
+    }
+    if (result == FALSE) {
+        return P2_TIMEOUT;
+    }
+    return P2_Wait(pid, status);
+}
+
+/*
+ * P2_ClockStats
+ *
+ * Copies the clock driver's wakeup statistics into info.
+ */
+int 
+P2_ClockStats(P2_ClockInfo *info)
+{
+    int rc;
+
+    if (info == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    rc = P1_Lock(lock);
+    assert(rc == P1_SUCCESS);
+    *info = stats;
+    rc = P1_Unlock(lock);
+    assert(rc == P1_SUCCESS);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_ProfileSetRate
+ *
+ * Makes the profiler sample every every-th clock interrupt. Zero turns it off, which is how it
+ * starts.
+ */
+int 
+P2_ProfileSetRate(int every)
+{
+    if (every < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    profileTicks = 0;
+    profileEvery = every;
+    if (every > 0) {
+        profiled = TRUE;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_Profile
+ *
+ * Copies the profiler's samples, indexed by pid, into samples, which must have P1_MAXPROC
+ * entries.
+ */
+int 
+P2_Profile(P2_ProfileSample *samples)
+{
+    unsigned int psr = USLOSS_PsrGet();
+
+    if (samples == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    // keep ProfileHandler out while copying
+    USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    memcpy(samples, profile, sizeof(profile));
+    USLOSS_PsrSet(psr);
     return P1_SUCCESS;
 }
 
+/*
+ * P2_TimePageGet
+ *
+ * Returns the time page. Callers must only read it.
+ */
+const P2_TimePage *
+P2_TimePageGet(void)
+{
+    return &timePage;
+}
+
 /*
  * SleepStub
  *
@@ -97,3 +1075,124 @@ SleepStub(USLOSS_Sysargs *sysargs)
     sysargs->arg4 = (void *) rc;
 }
 
+/*
+ * SleepMsStub
+ *
+ * Stub for the Sys_SleepMs system call.
+ */
+static void 
+SleepMsStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_SleepMs((int) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * SleepUntilStub
+ *
+ * Stub for the Sys_SleepUntil system call.
+ */
+static void 
+SleepUntilStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_SleepUntil((int) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TimerCreateStub
+ *
+ * Stub for the Sys_TimerCreate system call.
+ */
+static void 
+TimerCreateStub(USLOSS_Sysargs *sysargs)
+{
+    int timerId = -1;
+    int rc = P2_TimerCreate((int) sysargs->arg1, &timerId);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) timerId;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TimerWaitStub
+ *
+ * Stub for the Sys_TimerWait system call.
+ */
+static void 
+TimerWaitStub(USLOSS_Sysargs *sysargs)
+{
+    int expirations = 0;
+    int rc = P2_TimerWait((int) sysargs->arg1, &expirations);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg2 = (void *) expirations;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TimerDeleteStub
+ *
+ * Stub for the Sys_TimerDelete system call.
+ */
+static void 
+TimerDeleteStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_TimerDelete((int) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitTimedStub
+ *
+ * Stub for the Sys_WaitTimed system call.
+ */
+static void 
+WaitTimedStub(USLOSS_Sysargs *sysargs)
+{
+    int pid = -1;
+    int status = 0;
+    int rc = P2_WaitTimed((int) sysargs->arg1, &pid, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * ClockStatsStub
+ *
+ * Stub for the Sys_ClockStats system call.
+ */
+static void 
+ClockStatsStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_ClockStats((P2_ClockInfo *) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * ProfileStub
+ *
+ * Stub for the Sys_Profile system call.
+ */
+static void 
+ProfileStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_Profile((P2_ProfileSample *) sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TimePageStub
+ *
+ * Stub for the system call that finds the time page.
+ */
+static void 
+TimePageStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg1 = (void *) P2_TimePageGet();
+    sysargs->arg4 = (void *) P1_SUCCESS;
+}
@@ -0,0 +1,109 @@
+
+/*
+ * test_profile.c
+ *
+ * Tests the clock-interrupt sampling profiler. A Spinner busy-waits in user mode for half a
+ * second while a Sleeper sleeps; the Spinner must collect user-mode samples and the Sleeper
+ * almost none. While the profiler is off a process spinning in kernel mode collects no samples.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define SPIN 500000     // microseconds the Spinner runs
+
+static P2_ProfileSample samples[P1_MAXPROC];
+
+int Spinner(void *arg) {
+    int start, now;
+
+    Sys_GetTimeOfDay(&start);
+    do {
+        Sys_GetTimeOfDay(&now);
+    } while (now - start < SPIN);
+    return 0;
+}
+
+int Sleeper(void *arg) {
+    int rc = Sys_Sleep(1);
+    TEST_RC(rc, P1_SUCCESS);
+    return 0;
+}
+
+int
+P3_Startup(void *arg)
+{
+    int status, rc, spinner, sleeper, pid;
+
+    rc = Sys_Spawn("Sleeper", Sleeper, NULL, USLOSS_MIN_STACK, 3, &sleeper);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Spinner", Spinner, NULL, USLOSS_MIN_STACK, 3, &spinner);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+
+    rc = Sys_Profile(samples);
+    TEST_RC(rc, P1_SUCCESS);
+    // half a second is about 25 clock interrupts
+    TEST(samples[spinner].user + samples[spinner].kernel >= 10, 1);
+    TEST(samples[spinner].user > 0, 1);
+    TEST(samples[sleeper].user + samples[sleeper].kernel <= 2, 1);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+    int before, start, now;
+
+    P2ClockInit();
+    rc = P2_ProfileSetRate(-1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    // off until turned on
+    rc = P2_ProfileSetRate(1);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+
+    // no samples are taken while the profiler is off
+    rc = P2_ProfileSetRate(0);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Profile(samples);
+    TEST_RC(rc, P1_SUCCESS);
+    before = samples[P1_GetPid()].kernel;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &start);
+    TEST(rc, USLOSS_DEV_OK);
+    do {
+        rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+        TEST(rc, USLOSS_DEV_OK);
+    } while (now - start < SPIN);
+    rc = P2_Profile(samples);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(samples[P1_GetPid()].kernel, before);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
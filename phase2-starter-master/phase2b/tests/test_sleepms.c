@@ -0,0 +1,146 @@
+
+/*
+ * test_sleepms.c
+ *
+ * Creates NUM_SLEEPERS children that sleep for 0-999 milliseconds with Sys_SleepMs, and a Ticker
+ * that runs a periodic loop with Sys_SleepUntil. Each sleeper checks that it slept at least as long
+ * as requested and at most one clock tick longer. The Ticker advances its deadline by a fixed
+ * period and checks that its wakeups don't drift. Finally the clock driver's statistics must
+ * account for every wakeup.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+#include <sys/time.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define NUM_SLEEPERS 20
+#define PERIOD 50000    // Ticker period in microseconds
+#define PERIODS 20
+#define SLACK 40000     // allowed lateness in microseconds
+
+/*
+ * Sleeper
+ *
+ * Sleeps for the number of milliseconds in arg and checks that it slept long enough.
+ *
+ */
+
+int Sleeper(void *arg) {
+    int start, end, rc;
+    int ms = (int) arg;
+    Sys_GetTimeOfDay(&start);
+    rc = Sys_SleepMs(ms);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&end);
+    int duration = end - start; // duration in us
+    TEST((duration >= ms * 1000) && (duration <= ms * 1000 + SLACK), 1);
+    return 0;
+}
+
+/*
+ * Ticker
+ *
+ * Wakes up every PERIOD microseconds. Each wakeup must be within SLACK of its deadline,
+ * independent of how late the previous wakeups were.
+ *
+ */
+
+int Ticker(void *arg) {
+    int start, end, rc;
+
+    Sys_GetTimeOfDay(&start);
+    for (int i = 1; i <= PERIODS; i++) {
+        int deadline = start + i * PERIOD;
+        rc = Sys_SleepUntil(deadline);
+        TEST_RC(rc, P1_SUCCESS);
+        Sys_GetTimeOfDay(&end);
+        TEST((end >= deadline) && (end <= deadline + SLACK), 1);
+    }
+
+    // a deadline in the past returns immediately
+    rc = Sys_SleepUntil(start);
+    TEST_RC(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * P3_Startup
+ *
+ * Creates the sleepers and the ticker.
+ *
+ */
+int
+P3_Startup(void *arg)
+{
+    int status, rc;
+    int pid = -1;
+    int total = 0;
+    P2_ClockInfo info;
+
+    rc = Sys_SleepMs(-1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    for (int i = 0; i < NUM_SLEEPERS; i++) {
+        int duration = random() % 1000;
+        rc = Sys_Spawn(MakeName("Sleeper", i), Sleeper, (void *) duration, USLOSS_MIN_STACK, 5, &pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_Spawn("Ticker", Ticker, NULL, USLOSS_MIN_STACK, 4, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    for (int i = 0; i < NUM_SLEEPERS + 1; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+
+    rc = Sys_ClockStats(&info);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < P2_CLOCK_LATENESS; i++) {
+        total += info.lateness[i];
+    }
+    TEST(total, info.wakeups);
+    // nothing should be more than a tick late on an idle system
+    TEST(info.lateness[0] + info.lateness[1], info.wakeups);
+    TEST(info.wakeups >= PERIODS, 1);
+    TEST(info.maxWoken >= 1, 1);
+    TEST(info.ticks > 0, 1);
+    TEST(info.maxHandlerTime <= info.handlerTime, 1);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    srandom(t.tv_sec);
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
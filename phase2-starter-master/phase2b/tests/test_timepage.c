@@ -0,0 +1,82 @@
+
+/*
+ * test_timepage.c
+ *
+ * Tests the time page. A Reader compares the coarse time read from the page with
+ * Sys_GetTimeOfDay: it must never be ahead and never more than a clock tick behind, and it must
+ * advance while the Reader sleeps.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define TICK (USLOSS_CLOCK_MS * 1000) // microseconds per clock tick
+#define SLACK 5000      // allowed extra lag in microseconds
+
+int Reader(void *arg) {
+    int coarse, precise, before, rc;
+
+    for (int i = 0; i < 10; i++) {
+        Sys_GetTime(&coarse, FALSE);
+        Sys_GetTime(&precise, TRUE);
+        TEST(coarse <= precise, 1);
+        TEST(precise - coarse <= TICK + SLACK, 1);
+        before = coarse;
+        rc = Sys_SleepMs(50);
+        TEST_RC(rc, P1_SUCCESS);
+        Sys_GetTimeCoarse(&coarse);
+        TEST(coarse - before >= 50000 - TICK, 1);
+    }
+    return 0;
+}
+
+int
+P3_Startup(void *arg)
+{
+    int status, rc, pid;
+
+    rc = Sys_Spawn("Reader", Reader, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+    const P2_TimePage *page;
+    int ticks;
+
+    P2ClockInit();
+    page = P2_TimePageGet();
+    ticks = page->ticks;
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+    // the Reader slept for half a second
+    TEST(page->ticks - ticks >= 20, 1);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,185 @@
+
+/*
+ * test_timer.c
+ *
+ * Tests periodic timers. A Heartbeat waits on a 100ms timer and checks that every expiration
+ * arrives on schedule. A Laggard sleeps through several periods of its timer and checks that the
+ * missed expirations are counted. A Waiter blocked on a timer is released when P3_Startup
+ * deletes it, and a timer is deleted when the process that created it terminates.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define PERIOD 100      // Heartbeat period in ms
+#define BEATS 10
+#define SLACK 40000     // allowed lateness in microseconds
+
+static int sharedTimer = -1;
+
+/*
+ * Heartbeat
+ *
+ * Each expiration of its timer must be within SLACK of the time it is due.
+ *
+ */
+
+int Heartbeat(void *arg) {
+    int start, end, rc;
+    int timer = -1;
+    int expirations = 0;
+
+    rc = Sys_TimerCreate(PERIOD, &timer);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&start);
+    for (int i = 1; i <= BEATS; i++) {
+        rc = Sys_TimerWait(timer, &expirations);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(expirations, 1);
+        Sys_GetTimeOfDay(&end);
+        TEST((end - start >= i * PERIOD * 1000 - SLACK) && (end - start <= i * PERIOD * 1000 + SLACK), 1);
+    }
+    rc = Sys_TimerDelete(timer);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_TimerDelete(timer);
+    TEST_RC(rc, P2_INVALID_TIMER);
+    return 0;
+}
+
+/*
+ * Laggard
+ *
+ * Sleeps through five periods of its timer, which must report them all at once.
+ *
+ */
+
+int Laggard(void *arg) {
+    int rc;
+    int timer = -1;
+    int expirations = 0;
+
+    rc = Sys_TimerCreate(40, &timer);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_SleepMs(190);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_TimerWait(timer, &expirations);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(expirations, 5);
+    rc = Sys_TimerDelete(timer);
+    TEST_RC(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Waiter
+ *
+ * Waits on a timer that is deleted before it expires.
+ *
+ */
+
+int Waiter(void *arg) {
+    int rc, expirations;
+
+    rc = Sys_TimerWait(sharedTimer, &expirations);
+    TEST_RC(rc, P2_INVALID_TIMER);
+    return 0;
+}
+
+/*
+ * Owner
+ *
+ * Creates a timer and terminates without deleting it.
+ *
+ */
+
+int Owner(void *arg) {
+    int rc;
+
+    rc = Sys_TimerCreate(PERIOD, &sharedTimer);
+    TEST_RC(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * P3_Startup
+ *
+ */
+int
+P3_Startup(void *arg)
+{
+    int rc;
+    int timer = -2;
+    int status = -2;
+    int pid = -1;
+
+    // outputs are left alone when a call fails
+    rc = Sys_TimerCreate(0, &timer);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    TEST(timer, -2);
+    rc = Sys_TimerWait(P2_MAX_TIMERS, &status);
+    TEST_RC(rc, P2_INVALID_TIMER);
+    TEST(status, -2);
+
+    rc = Sys_Spawn("Heartbeat", Heartbeat, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Laggard", Laggard, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    // a waiter is released when its timer is deleted
+    rc = Sys_TimerCreate(10000, &sharedTimer);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Waiter", Waiter, NULL, USLOSS_MIN_STACK, 1, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_TimerDelete(sharedTimer);
+    TEST_RC(rc, P1_SUCCESS);
+
+    for (int i = 0; i < 3; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(status, 0);
+    }
+
+    // a timer goes away with the process that created it
+    rc = Sys_Spawn("Owner", Owner, NULL, USLOSS_MIN_STACK, 1, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_TimerWait(sharedTimer, &status);
+    TEST_RC(rc, P2_INVALID_TIMER);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,161 @@
+/*
+ * test_ulock.c
+ *
+ * Tests the user-level locks and condition variables in ulock.h. Uncontended acquires and
+ * releases, and signals with no waiters, must not make any futex system calls. A Contender that
+ * finds the lock held by a sleeping Holder must block until the Holder releases it, and a
+ * Consumer waiting on a condition must be woken by the Producer's signal.
+ *
+ */
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "ulock.h"
+
+#define ITERATIONS 1000
+#define HOLD 100        // milliseconds the Holder keeps the lock
+
+static ULock lock;
+static UCond cond;
+static int inside = FALSE;      // TRUE while the Holder has the lock
+static int done = 0;            // critical sections completed
+static int ready = FALSE;       // set by the Producer
+
+int Holder(void *arg) {
+    int rc;
+
+    ULock_Acquire(&lock);
+    inside = TRUE;
+    // the Contender runs while we sleep
+    rc = Sys_SleepMs(HOLD);
+    TEST_RC(rc, P1_SUCCESS);
+    inside = FALSE;
+    done++;
+    ULock_Release(&lock);
+    return 0;
+}
+
+int Contender(void *arg) {
+    ULock_Acquire(&lock);
+    TEST(inside, FALSE);
+    TEST(done, 1);
+    done++;
+    ULock_Release(&lock);
+    return 0;
+}
+
+int Consumer(void *arg) {
+    ULock_Acquire(&lock);
+    while (!ready) {
+        UCond_Wait(&cond, &lock);
+    }
+    ULock_Release(&lock);
+    return 0;
+}
+
+int Producer(void *arg) {
+    int rc = Sys_SleepMs(HOLD);
+    TEST_RC(rc, P1_SUCCESS);
+    ULock_Acquire(&lock);
+    ready = TRUE;
+    UCond_Signal(&cond);
+    ULock_Release(&lock);
+    return 0;
+}
+
+/*
+ * Run
+ *
+ * Spawns the two functions, in order, and waits for both.
+ */
+static void Run(char *name1, int (*func1)(void *), char *name2, int (*func2)(void *))
+{
+    int pids[2];
+    int statuses[2];
+    int rc, pid, count;
+
+    rc = Sys_Spawn(name1, func1, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn(name2, func2, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_WaitN(2, pids, statuses, &count);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(count, 2);
+}
+
+int
+P3_Startup(void *arg)
+{
+    P2_SyscallInfo waits, wakes, info;
+    int rc, woken;
+
+    ULock_Init(&lock);
+    UCond_Init(&cond);
+    rc = Sys_FutexWake(NULL, 1, &woken);
+    TEST_RC(rc, P2_NULL_ADDRESS);
+    // the value has changed, so this returns at once
+    rc = Sys_FutexWait(&done, done + 1);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = Sys_SyscallStats(SYS_FUTEXWAIT, &waits);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_SyscallStats(SYS_FUTEXWAKE, &wakes);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < ITERATIONS; i++) {
+        ULock_Acquire(&lock);
+        UCond_Signal(&cond);
+        ULock_Release(&lock);
+    }
+    rc = Sys_SyscallStats(SYS_FUTEXWAIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, waits.calls);
+    rc = Sys_SyscallStats(SYS_FUTEXWAKE, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls, wakes.calls);
+
+    Run("Holder", Holder, "Contender", Contender);
+    TEST(done, 2);
+    Run("Consumer", Consumer, "Producer", Producer);
+    TEST(ready, TRUE);
+
+    // the contended cases trapped
+    rc = Sys_SyscallStats(SYS_FUTEXWAIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls >= waits.calls + 2, 1);
+    rc = Sys_SyscallStats(SYS_FUTEXWAKE, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.calls >= wakes.calls + 2, 1);
+    TEST(lock.state, ULOCK_FREE);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,121 @@
+
+/*
+ * test_waittimed.c
+ *
+ * Tests P2_WaitTimed. P3_Startup spawns a Napper that sleeps for one second. A wait with a 100ms
+ * timeout must fail with P2_TIMEOUT, take about 100ms, and not consume the child; a wait with a
+ * two second timeout must return the Napper as soon as it quits. With no children left the wait
+ * fails at once. A kernel child that quits while a spawned Napper sleeps must not end a timed
+ * wait, which still times out on time rather than waiting for the Napper.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define SLACK 40000     // allowed lateness in microseconds
+
+int Napper(void *arg) {
+    int rc = Sys_Sleep(1);
+    TEST_RC(rc, P1_SUCCESS);
+    return 42;
+}
+
+int
+P3_Startup(void *arg)
+{
+    int rc, start, end;
+    int status = -2;
+    int pid = -2;
+    int napper;
+
+    rc = Sys_Spawn("Napper", Napper, NULL, USLOSS_MIN_STACK, 3, &napper);
+    TEST_RC(rc, P1_SUCCESS);
+
+    Sys_GetTimeOfDay(&start);
+    rc = Sys_WaitTimed(100, &pid, &status);
+    TEST_RC(rc, P2_TIMEOUT);
+    // outputs are left alone when the wait fails
+    TEST(pid, -2);
+    TEST(status, -2);
+    Sys_GetTimeOfDay(&end);
+    TEST((end - start >= 100000) && (end - start <= 100000 + SLACK), 1);
+
+    rc = Sys_WaitTimed(2000, &pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&end);
+    TEST(pid, napper);
+    TEST(status, 42);
+    TEST((end - start >= 1000000) && (end - start <= 1000000 + SLACK), 1);
+
+    rc = Sys_WaitTimed(2000, &pid, &status);
+    TEST_RC(rc, P1_NO_CHILDREN);
+    return 11;
+}
+
+int Quick(void *arg) {
+    return 7;
+}
+
+static int Now(void)
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+    int napper, quick, start;
+
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_WaitTimed(-1, &waitPid, &status);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    rc = P2_Spawn("Napper", Napper, NULL, USLOSS_MIN_STACK, 3, &napper);
+    TEST_RC(rc, P1_SUCCESS);
+    // runs and quits at once
+    rc = P1_Fork("Quick", Quick, NULL, USLOSS_MIN_STACK, 1, &quick);
+    TEST_RC(rc, P1_SUCCESS);
+    start = Now();
+    rc = P2_WaitTimed(100, &waitPid, &status);
+    TEST_RC(rc, P2_TIMEOUT);
+    TEST(Now() - start <= 100000 + SLACK, 1);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, napper);
+    TEST(status, 42);
+    rc = P2_WaitTimed(100, &waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, quick);
+    TEST(status, 7);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,89 @@
+
+/*
+ * test_wakeorder.c
+ *
+ * Spawns Sleepers of different priorities, in no particular order, that all sleep until the same
+ * time. All of them must wake up, none before the deadline, in priority order, and the clock
+ * driver must wake all of them in one interrupt.
+ *
+ */
+
+
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+static int priorities[] = {5, 3, 4, 5, 3, 4};
+static int numSleepers = sizeof(priorities) / sizeof(int);
+static int deadline;
+static int order[10];
+static int woken = 0;
+
+int Sleeper(void *arg) {
+    int now;
+    int rc = Sys_SleepUntil(deadline);
+    TEST_RC(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&now);
+    TEST(now >= deadline, 1);
+    order[woken++] = (int) arg;
+    return 0;
+}
+
+int
+P3_Startup(void *arg)
+{
+    int status, rc, pid;
+    P2_ClockInfo info;
+
+    Sys_GetTimeOfDay(&deadline);
+    deadline += 200000;
+    for (int i = 0; i < numSleepers; i++) {
+        rc = Sys_Spawn(MakeName("Sleeper", i), Sleeper, (void *) priorities[i], USLOSS_MIN_STACK,
+                       priorities[i], &pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < numSleepers; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    TEST(woken, numSleepers);
+    for (int i = 1; i < woken; i++) {
+        TEST(order[i - 1] <= order[i], 1);
+    }
+    rc = Sys_ClockStats(&info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.maxWoken >= numSleepers, 1);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {}
+
+void finish(int argc, char **argv) {}
@@ -9,29 +9,130 @@
 #include <phase1.h>
 
 #include "phase2Int.h"
+#include "phase2ExtInt.h"
 
 
 static int      DiskDriver(void *);
 static void     ReadStub(USLOSS_Sysargs *sysargs);
 static void     WriteStub(USLOSS_Sysargs *sysargs);
 static void     SizeStub(USLOSS_Sysargs *sysargs);
+static void     DiskExit(int pid);
+static void     HeatmapStub(USLOSS_Sysargs *sysargs);
+static void     ReadTimedStub(USLOSS_Sysargs *sysargs);
+static void     WriteTimedStub(USLOSS_Sysargs *sysargs);
+static void     ReadAsyncStub(USLOSS_Sysargs *sysargs);
+static void     WriteAsyncStub(USLOSS_Sysargs *sysargs);
+static void     CollectStub(USLOSS_Sysargs *sysargs);
+static int      DiskReady(int ticket);
+
+
+// states of a request in pools
+#define POOL_QUEUED     0   // waiting for the driver to pick it
+#define POOL_ACTIVE     1   // driver is performing it
+#define POOL_DONE       2   // driver has finished it, rc is valid
 
 typedef struct Pool{
     int first; // values between 0-15
     int sectors; // the amount of secors to read/write
     int unit; // unit of disk driver (0 or 1)
     int track; // calculated when being created
-    USLOSS_DeviceRequest *task;
+    int opr; // USLOSS_DISK_READ, USLOSS_DISK_WRITE or USLOSS_DISK_TRACKS
     void *buffer; // What will be filled by disk
     int condId; // condition variable this task is waiting on
+    int state; // POOL_QUEUED, POOL_ACTIVE or POOL_DONE
+    int rc; // result of the request, set by the driver
+    int seq; // arrival order on the unit, used by FCFS
+    int policy; // policy that chose this request, for accounting
+    int pid; // process that made the request
+    int cancelled; // TRUE if the process terminated while the request was being performed
 } Pool;
 
 Pool *pools[P1_MAXPROC];
+static Pool entries[P1_MAXPROC]; // storage for pools, one request per process
+static int condIds[P1_MAXPROC]; // per-process condition variables for request completion
 int currentTrack[2];
+static int numTracks[USLOSS_DISK_UNITS]; // size of each disk in tracks, -1 until known
+static P2_TrackHeat *heatmaps[USLOSS_DISK_UNITS]; // per-track access counts, numTracks entries
+static char *heatmapFile; // where P2DiskShutdown writes the heatmaps, NULL if nowhere
 
 int lockId;
-// state variable
-int poolSize;
+
+/*
+ * Admission control. Each unit admits at most maxDepth[unit] outstanding requests (queued plus
+ * the one being performed). Blocking callers that find the unit full take a ticket and wait on
+ * roomCond[unit] until their ticket is served, so they are admitted in FIFO order. The try
+ * variants never take a ticket; they fail with P2_DISK_BUSY if the unit is full or anyone is
+ * already waiting for room. A timed caller that gives up marks its ticket abandoned so that it
+ * is skipped.
+ */
+static int depth[USLOSS_DISK_UNITS]; // outstanding requests per unit
+static int maxDepth[USLOSS_DISK_UNITS]; // configured queue depth limit per unit
+static int nextTicket[USLOSS_DISK_UNITS]; // next ticket handed to a blocked caller
+static int nowServing[USLOSS_DISK_UNITS]; // ticket allowed to be admitted next
+static int roomCond[USLOSS_DISK_UNITS]; // signaled when a request on the unit completes
+static int workCond[USLOSS_DISK_UNITS]; // signaled when a request is added to the unit
+static int shuttingDown;
+static int arrivals[USLOSS_DISK_UNITS]; // sequence number for the next request on each unit
+// tickets whose holders timed out, indexed by ticket % P1_MAXPROC
+static int abandoned[USLOSS_DISK_UNITS][P1_MAXPROC];
+static int timedOut[P1_MAXPROC]; // TRUE once the timeout of the process's request expired
+
+/*
+ * Asynchronous requests. A process may have one outstanding request that it didn't wait for,
+ * held in its entry like any other; its ticket is the process's pid. The driver leaves the entry
+ * DONE until the process collects the result, and a read served from the cache is DONE at once.
+ */
+static int submitted[P1_MAXPROC]; // TRUE while the process has a request it hasn't collected
+
+/*
+ * Scheduling. Each unit uses one of P2_DISK_FCFS, P2_DISK_SSTF or P2_DISK_LOOK. In adaptive mode
+ * the driver keeps moving averages of the number of queued requests and of their distance from
+ * the head, sampled whenever it picks a request, and switches policy when they cross the
+ * thresholds: FCFS while the queue is shallow or the requests are close together (reordering
+ * gains nothing), SSTF at moderate depth, and LOOK when the queue is deep enough that SSTF could
+ * starve requests far from the head.
+ */
+#define SCALE           100 // fixed point scale for the moving averages
+#define AVG_WEIGHT      8   // each sample contributes 1/AVG_WEIGHT to an average
+
+typedef struct Sched {
+    int adaptive; // TRUE if the policy follows the averages
+    int direction; // LOOK sweep direction, 1 (up) or -1 (down)
+    int fcfsDepth; // average depth below which FCFS is used
+    int lookDepth; // average depth at or above which LOOK is used
+    int minSeek; // average seek distance below which FCFS is used
+    P2_DiskSchedInfo info; // counters, averages and policy changes
+} Sched;
+
+static Sched sched[USLOSS_DISK_UNITS];
+
+/*
+ * Track cache. Each entry holds the sectors of one track that have been read or written, with
+ * bit i of valid set if sector i is present. Reads that find every sector they need are served
+ * without going to the driver. Foreground I/O replaces the least recently used entry when all
+ * cacheBudget entries are in use; prefetching never replaces anything and stops at that point.
+ * Prefetching is done by the driver only when the unit has no requests, so foreground requests
+ * are always served first. The budget is 0 until P2_DiskSetCacheBudget raises it, so by default
+ * every read goes to the driver. A read served from the cache is charged to the caller but never
+ * reaches the driver, so it isn't counted by the scheduler or in the heatmap.
+ */
+typedef struct CacheEntry {
+    int unit; // -1 if the entry is free
+    int track;
+    int valid; // bitmask of cached sectors
+    int lastUse; // value of cacheClock when last used
+    char data[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+} CacheEntry;
+
+static CacheEntry cache[P2_DISK_CACHE_TRACKS];
+static int cacheBudget; // number of entries that may be used
+static int cacheClock; // incremented on every use of the cache
+static P2_DiskCacheInfo cacheInfo;
+
+// tracks to prefetch, from P2_DiskWarmStart
+static int prefetch[USLOSS_DISK_UNITS][P2_DISK_CACHE_TRACKS];
+static int numPrefetch[USLOSS_DISK_UNITS];
+static int nextPrefetch[USLOSS_DISK_UNITS];
 
 static char *
 MakeName(char *prefix, int suffix)
@@ -55,12 +156,49 @@ P2DiskInit(void)
     // initialize data structures here including lock and condition variables
     rc = P1_LockCreate("lock", &lockId);
     assert(rc == P1_SUCCESS);
-    poolSize = 0;
+    shuttingDown = FALSE;
+    heatmapFile = NULL;
 
     for(i = 0; i < P1_MAXPROC; i++){
         pools[i] = NULL;
+        submitted[i] = FALSE;
+        rc = P1_CondCreate(MakeName("Disk Request ", i), lockId, &condIds[i]);
+        assert(rc == P1_SUCCESS);
+    }
+
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        depth[unit] = 0;
+        maxDepth[unit] = P2_DISK_DEFAULT_DEPTH;
+        nextTicket[unit] = 0;
+        nowServing[unit] = 0;
+        memset(abandoned[unit], 0, sizeof(abandoned[unit]));
+        numTracks[unit] = -1;
+        heatmaps[unit] = NULL;
+        arrivals[unit] = 0;
+        numPrefetch[unit] = 0;
+        nextPrefetch[unit] = 0;
+        memset(&sched[unit], 0, sizeof(Sched));
+        sched[unit].info.policy = P2_DISK_SSTF;
+        sched[unit].direction = 1;
+        sched[unit].fcfsDepth = P2_DISK_FCFS_DEPTH;
+        sched[unit].lookDepth = P2_DISK_LOOK_DEPTH;
+        sched[unit].minSeek = P2_DISK_MIN_SEEK;
+        rc = P1_CondCreate(MakeName("Disk Room ", unit), lockId, &roomCond[unit]);
+        assert(rc == P1_SUCCESS);
+        rc = P1_CondCreate(MakeName("Disk Work ", unit), lockId, &workCond[unit]);
+        assert(rc == P1_SUCCESS);
     }
 
+    for (i = 0; i < P2_DISK_CACHE_TRACKS; i++) {
+        cache[i].unit = -1;
+    }
+    cacheBudget = 0;
+    cacheClock = 0;
+    memset(&cacheInfo, 0, sizeof(cacheInfo));
+
+    P2AddExitHook(DiskExit);
+    P2AddEventSource(P2_EVENT_DISK, DiskReady);
+
     rc = P2_SetSyscallHandler(SYS_DISKREAD, ReadStub);
     assert(rc == P1_SUCCESS);
 
@@ -70,301 +208,1376 @@ P2DiskInit(void)
     rc = P2_SetSyscallHandler(SYS_DISKSIZE, SizeStub);
     assert(rc == P1_SUCCESS);
 
+    rc = P2_SetSyscallHandler(SYS_DISKHEATMAP, HeatmapStub);
+    assert(rc == P1_SUCCESS);
+
+    rc = P2_SetSyscallHandler(SYS_DISKREADTIMED, ReadTimedStub);
+    assert(rc == P1_SUCCESS);
+
+    rc = P2_SetSyscallHandler(SYS_DISKWRITETIMED, WriteTimedStub);
+    assert(rc == P1_SUCCESS);
+
+    rc = P2_SetSyscallHandler(SYS_DISKREADASYNC, ReadAsyncStub);
+    assert(rc == P1_SUCCESS);
+
+    rc = P2_SetSyscallHandler(SYS_DISKWRITEASYNC, WriteAsyncStub);
+    assert(rc == P1_SUCCESS);
+
+    rc = P2_SetSyscallHandler(SYS_DISKCOLLECT, CollectStub);
+    assert(rc == P1_SUCCESS);
+
+    currentTrack[0] = 0;
+    currentTrack[1] = 0;
     for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
         int pid;
         rc = P1_Fork(MakeName("Disk Driver ", unit), DiskDriver, (void *) unit, USLOSS_MIN_STACK*4, 
                      1, &pid);
         assert(rc == P1_SUCCESS);
     }
-    currentTrack[0] = 0;
-    currentTrack[1] = 0;
 }
 
 /*
- * P2DiskShutdown
+ * DumpHeatmaps
  *
- * Stop the disk drivers.
+ * Writes the per-track access counts of all units to path as CSV, one line per track that was
+ * touched.
  */
+static void 
+DumpHeatmaps(char *path)
+{
+    FILE *f = fopen(path, "w");
 
-void 
-P2DiskShutdown(void) {
-    if(P1_DeviceAbort(USLOSS_DISK_DEV, 1));
-    if(P1_DeviceAbort(USLOSS_DISK_DEV, 2));
+    if (f == NULL) {
+        USLOSS_Console("Unable to write disk heatmap to %s.\n", path);
+        return;
+    }
+    fprintf(f, "unit,track,reads,writes,seeks\n");
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        for (int track = 0; heatmaps[unit] != NULL && track < numTracks[unit]; track++) {
+            P2_TrackHeat *h = &heatmaps[unit][track];
+            if (h->reads || h->writes || h->seeks) {
+                fprintf(f, "%d,%d,%d,%d,%d\n", unit, track, h->reads, h->writes, h->seeks);
+            }
+        }
+    }
+    fclose(f);
 }
 
 /*
- * DiskDriver
+ * WriteManifest
  *
- * Kernel process that manages a disk device and services disk I/O requests from other processes.
- * Note that it may require several disk operations to service a single I/O request. A disk
- * operation is performed by sending a request of type USLOSS_DeviceRequest to the disk via
- * USLOSS_DeviceOutput, then waiting for the operation to finish via P1_WaitDevice. The status
- * returned by P1_WaitDevice will tell you if the operation was successful or not.
+ * Writes the hottest tracks, by sectors read and written, to path so that a later run can warm
+ * its cache with P2_DiskWarmStart. Only as many tracks as fit in the cache are written, hottest
+ * first, one "unit track" pair per line.
  */
-
- // TODO: What is he talking bout with P1_WaitDevice()
-static int 
-DiskDriver(void *arg) 
+static void 
+WriteManifest(char *path)
 {
-    int unit = (int) arg;
-    int status;
-    int rc;
-    int shortestIndex; // index of pools with the shortest job
-    int shortestDistance;
-    int i;
-    int sectorsTouched = 0; // represent the sectors touched while looping though
-    int start;
-    Pool *currentTask;
-    USLOSS_DeviceRequest *req = malloc(sizeof(USLOSS_DeviceRequest));
-    /****
-    repeat
-        choose request with shortest seek from current track
-        seek to proper track if necessary
-        while request isn't complete
-             for all sectors to be read/written in current track
-                read/write sector
-             seek to next track
-        wake the waiting process
-    until P2DiskShutdown has been called
-    ****/
-    while(1){
-        // TODO: I dont know how to start this while its waiting for an interrupt
-        if(poolSize == 0){
-            rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
-            assert(status == USLOSS_DEV_READY);
-            if (rc == P1_WAIT_ABORTED) {
-                break;
+    int doneUnit[P2_DISK_CACHE_TRACKS]; // tracks already written
+    int doneTrack[P2_DISK_CACHE_TRACKS];
+    int count = 0;
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL) {
+        USLOSS_Console("Unable to write disk cache manifest to %s.\n", path);
+        return;
+    }
+    for (count = 0; count < cacheBudget; count++) {
+        int bestUnit = -1;
+        int bestTrack = -1;
+        int bestHeat = 0;
+        for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+            for (int track = 0; heatmaps[unit] != NULL && track < numTracks[unit]; track++) {
+                int h = heatmaps[unit][track].reads + heatmaps[unit][track].writes;
+                int skip = FALSE;
+                for (int j = 0; j < count; j++) {
+                    if (doneUnit[j] == unit && doneTrack[j] == track) {
+                        skip = TRUE;
+                        break;
+                    }
+                }
+                if (!skip && h > bestHeat) {
+                    bestHeat = h;
+                    bestUnit = unit;
+                    bestTrack = track;
+                }
             }
         }
-        if(P1_Lock(lockId));
-        // finds the shortest distance for the head to move
-        for(i = 0; i < P1_MAXPROC; i++){
-            // If there is nothing there go on to the next one
-            if(pools[i] == NULL){
-                continue;
-            }
-            // Checks if proper unit and the current track is the same being used
-            if(pools[i]->unit == unit && pools[i]->track == currentTrack[unit]){
-                shortestIndex = i;
-                break;
-            }
-            // Checks to see if the instruction is a size instruction
-            if(pools[i]->unit == unit && pools[i]->task->opr == USLOSS_DISK_TRACKS){
-                shortestIndex = i;
-                break;
-            }
-            if(pools[i]->unit == unit && abs(pools[i]->track - currentTrack[unit]) < shortestDistance){
-                shortestDistance = pools[i]->track - currentTrack[unit];
-                shortestIndex = i;
-            }
+        if (bestUnit == -1) {
+            break;
         }
-        if(P1_Unlock(lockId));
+        doneUnit[count] = bestUnit;
+        doneTrack[count] = bestTrack;
+        fprintf(f, "%d %d\n", bestUnit, bestTrack);
+    }
+    fclose(f);
+}
 
-        // seeks proper track if necessary
-        currentTask = pools[shortestIndex];
-        if(currentTask->track != currentTrack[unit]){
-            req->opr = USLOSS_DISK_SEEK;
-            req->reg1 = (void*) currentTask->track;
-            if(USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, req));
-            // Makes sure the device has returned properly from changing track
-            rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
-            assert(status == USLOSS_DEV_READY);
-            if (rc == P1_WAIT_ABORTED) {
-                break;
-            }
+/*
+ * P2_DiskWarmStart
+ *
+ * Reads a manifest written by P2DiskShutdown and has the drivers prefetch the tracks it lists
+ * into the cache while they are otherwise idle. Only as many tracks as the cache budget allows
+ * are prefetched, so the budget must be set first. A missing manifest is not an error.
+ */
+int 
+P2_DiskWarmStart(char *path)
+{
+    FILE *f;
+    int unit;
+    int track;
+
+    if (path == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return P1_SUCCESS;
+    }
+    if(P1_Lock(lockId));
+    while (fscanf(f, "%d %d", &unit, &track) == 2) {
+        if ((unit < 0) || (unit >= USLOSS_DISK_UNITS) || (track < 0) ||
+            (numPrefetch[unit] == P2_DISK_CACHE_TRACKS)) {
+            continue;
         }
-        
-        // loops until all sectors asked to be visited have been
-        start = currentTask->first;
-        while(1){
-            // check for size
-            if(currentTask->task->opr == USLOSS_DISK_TRACKS){
-                if(USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, currentTask->task));
-                rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
-                assert(status == USLOSS_DEV_READY);
-                if (rc == P1_WAIT_ABORTED) {
-                    break;
-                }
-                break;
-            }
-            // goes through all sectors in a track
-            for(i = start; i < 16; i++){
-                // checks if all that needs to be seen has been seen
-                if(sectorsTouched == currentTask->sectors){
-                    break;
-                }
-                // writes/reads sector
-                // TODO: give only 512 bytes of the buffer to read/write each time
-                if(USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, currentTask->task));
-                rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
-                assert(status == USLOSS_DEV_READY);
-                if (rc == P1_WAIT_ABORTED) {
-                    break;
-                }
-                // NOTE: Watch out for a fight
-                currentTask->task->reg2 = currentTask->task->reg2 + (sizeof(char) * 512);
-                sectorsTouched++;
-            }
-            // checks if seen all sectors requested
-            if(sectorsTouched == currentTask->sectors){
-                break;
-            }
-            // go to next track
-            req->opr = USLOSS_DISK_SEEK;
-            req->reg1 = (void *) currentTrack[unit] + 1;
-            if(USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, req));
-            // Makes sure the device has returned properly from changing track
-            rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
-            assert(status == USLOSS_DEV_READY);
-            if (rc == P1_WAIT_ABORTED) {
-                break;
+        prefetch[unit][numPrefetch[unit]++] = track;
+    }
+    for (unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        if(P1_Signal(workCond[unit]));
+    }
+    if(P1_Unlock(lockId));
+    fclose(f);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskSetCacheBudget
+ *
+ * Sets the number of tracks the cache may hold. The budget starts at 0, which turns the cache
+ * off. Shrinking the budget drops the least recently used tracks.
+ */
+int 
+P2_DiskSetCacheBudget(int tracks)
+{
+    if ((tracks < 0) || (tracks > P2_DISK_CACHE_TRACKS)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    if(P1_Lock(lockId));
+    cacheBudget = tracks;
+    while (cacheInfo.used > cacheBudget) {
+        CacheEntry *victim = NULL;
+        for (int i = 0; i < P2_DISK_CACHE_TRACKS; i++) {
+            if ((cache[i].unit != -1) && ((victim == NULL) || (cache[i].lastUse < victim->lastUse))) {
+                victim = &cache[i];
             }
-            // update current track and set start of sectors to 0
-            currentTrack[unit]++;
-            start = 0;
         }
-        if(P1_Signal(currentTask->condId));
+        victim->unit = -1;
+        cacheInfo.used--;
     }
-    USLOSS_Console("DiskDriver PID %d unit %d exiting.\n", P1_GetPid(), unit);
-    return 0;
+    if(P1_Unlock(lockId));
+    return P1_SUCCESS;
 }
 
 /*
- * P2_DiskRead
+ * P2_DiskCacheStats
  *
- * Reads the specified number of sectors from the disk starting at the first sector.
- * First is the first sector that wants to be read, sectors is the amount of sectors
- * wanted to be read starting at first.
+ * Copies the cache counters.
  */
 int 
-P2_DiskRead(int unit, int first, int sectors, void *buffer) 
+P2_DiskCacheStats(P2_DiskCacheInfo *info)
 {
-    int index = P1_GetPid();
-    int rc;
-    char* indexStr[50];
-    USLOSS_DeviceRequest *req = malloc(sizeof(USLOSS_DeviceRequest));
-    // validate parameters
-    // give request to the unit's device driver
-    pools[index] = (Pool *)malloc(sizeof(Pool));
-
-    req->opr = USLOSS_DISK_READ;
-    req->reg1 = (void*) first;
-    req->reg2 = buffer;
-    pools[index]->task = req;
-    pools[index]->first = first % 16;
-    pools[index]->sectors = sectors;
-    pools[index]->unit = unit;
-    pools[index]->track = first / 16;
-    pools[index]->buffer = buffer;
-    sprintf(*indexStr,"%i",index);
-    rc = P1_CondCreate(*indexStr, lockId,  &pools[index]->condId);
-    assert(rc == P1_SUCCESS);
-    // wait until device driver completes the request
-    if(P1_Wait(pools[index]->condId));                      // note this might not be spinning
-    free(pools[index]);
-    pools[index] = NULL;
+    if (info == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if(P1_Lock(lockId));
+    *info = cacheInfo;
+    info->budget = cacheBudget;
+    if(P1_Unlock(lockId));
     return P1_SUCCESS;
 }
 
 /*
- * P2_DiskWrite
+ * P2DiskShutdown
  *
- * Writes the specified number of sectors to the disk starting at the first sector.
+ * Stop the disk drivers.
+ */
+
+void 
+P2DiskShutdown(void) {
+    int cached;
+
+    if(P1_Lock(lockId));
+    shuttingDown = TRUE;
+    cached = (cacheBudget > 0);
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        if(P1_Broadcast(workCond[unit]));
+    }
+    if(P1_Unlock(lockId));
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        if(P1_DeviceAbort(USLOSS_DISK_DEV, unit));
+    }
+    if (heatmapFile != NULL) {
+        DumpHeatmaps(heatmapFile);
+    }
+    // only a run that used the cache has a manifest to leave for the next one
+    if (cached) {
+        WriteManifest(P2_DISK_MANIFEST);
+    }
+}
+
+/*
+ * P2_DiskSetQueueDepth
+ *
+ * Sets the maximum number of outstanding requests on a unit. Requests already admitted are not
+ * affected; a lower limit takes effect as they complete.
  */
 int 
-P2_DiskWrite(int unit, int first, int sectors, void *buffer) 
+P2_DiskSetQueueDepth(int unit, int limit)
 {
-    int index = P1_GetPid();
-    int rc;
-    char* indexStr[50];
-    USLOSS_DeviceRequest *req = malloc(sizeof(USLOSS_DeviceRequest));
-    // validate parameters
-    // give request to the unit's device driver
-    pools[index] = (Pool *)malloc(sizeof(Pool));
-
-    req->opr = USLOSS_DISK_WRITE;
-    req->reg1 = (void *)first;
-    req->reg2 = buffer;
-    pools[index]->task = req;
-    pools[index]->first = first % 16;
-    pools[index]->sectors = sectors;
-    pools[index]->unit = unit;
-    pools[index]->track = first / 16;
-    pools[index]->buffer = buffer;
-    sprintf(*indexStr,"%i",index);
-    rc = P1_CondCreate(*indexStr, lockId, &pools[index]->condId);
-    assert(rc == P1_SUCCESS);
-    // wait until device driver completes the request
-    if(P1_Wait(pools[index]->condId));                      // note might not be spinning
-    free(pools[index]);
-    pools[index] = NULL;
+    if ((unit < 0) || (unit >= USLOSS_DISK_UNITS)) {
+        return P1_INVALID_UNIT;
+    }
+    if ((limit < 1) || (limit > P1_MAXPROC)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    if(P1_Lock(lockId));
+    maxDepth[unit] = limit;
+    // a higher limit may let blocked callers in
+    if(P1_Broadcast(roomCond[unit]));
+    if(P1_Unlock(lockId));
     return P1_SUCCESS;
 }
 
 /*
- * P2_DiskSize
+ * CurrentTime
  *
- * Returns the size of the disk.
+ * Returns the current time in microseconds from the clock device.
  */
-int 
-P2_DiskSize(int unit, int *sector, int *disk) 
+static int 
+CurrentTime(void)
 {
-    int index = P1_GetPid();
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+/*
+ * DiskIO
+ *
+ * Performs a single operation on the disk and waits for it to finish. Returns P1_SUCCESS,
+ * P1_WAIT_ABORTED if the driver is being shut down, or USLOSS_DEV_ERROR if the disk failed.
+ */
+static int 
+DiskIO(int unit, int opr, void *reg1, void *reg2)
+{
+    USLOSS_DeviceRequest req;
+    int status;
     int rc;
-    char* indexStr[50];
-    USLOSS_DeviceRequest *req = malloc(sizeof(USLOSS_DeviceRequest));
-    // validate parameter
-    // give request to the unit's device driver
-    pools[index] = (Pool *)malloc(sizeof(Pool));
-
-    req->opr = USLOSS_DISK_TRACKS;
-    req->reg1 = disk;
-    pools[index]->task = req;
-    pools[index]->first = 0;
-    pools[index]->sectors = 0;
-    pools[index]->unit = unit;
-    pools[index]->track = 0;
-    pools[index]->buffer = NULL;
-    sprintf(*indexStr,"%i",index);
-    rc = P1_CondCreate(*indexStr, lockId, &pools[index]->condId);
-    assert(rc == P1_SUCCESS);
-    // wait until device driver completes the request
-    if(P1_Wait(pools[index]->condId));                      // note might not be spinning
-    *disk = *disk * 16;
-    *sector = 512;
-    free(pools[index]);
-    pools[index] = NULL;
+
+    req.opr = opr;
+    req.reg1 = reg1;
+    req.reg2 = reg2;
+    if(USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, &req));
+    rc = P1_DeviceWait(USLOSS_DISK_DEV, unit, &status);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    if (status == USLOSS_DEV_ERROR) {
+        return USLOSS_DEV_ERROR;
+    }
     return P1_SUCCESS;
 }
 
-static void 
-ReadStub(USLOSS_Sysargs *sysargs) 
+/*
+ * CacheFind
+ *
+ * Returns the cache entry for a track, or NULL if it isn't cached. If create is TRUE a missing
+ * track gets an empty entry if the cache has room; if it is full the least recently used entry
+ * is replaced when replace is TRUE, and NULL is returned otherwise. Called with the lock held.
+ */
+static CacheEntry *
+CacheFind(int unit, int track, int create, int replace)
 {
-    int     rc;
-    rc = P2_DiskRead((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, sysargs->arg1);
-    sysargs->arg4 = (void *) rc;
+    CacheEntry *empty = NULL;
+    CacheEntry *victim = NULL;
+
+    for (int i = 0; i < P2_DISK_CACHE_TRACKS; i++) {
+        if (cache[i].unit == unit && cache[i].track == track) {
+            cache[i].lastUse = cacheClock++;
+            return &cache[i];
+        }
+        if (cache[i].unit == -1) {
+            empty = &cache[i];
+        } else if (victim == NULL || cache[i].lastUse < victim->lastUse) {
+            victim = &cache[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (cacheInfo.used < cacheBudget) {
+        assert(empty != NULL);
+        cacheInfo.used++;
+        victim = empty;
+    } else if (!replace || victim == NULL) {
+        return NULL;
+    }
+    victim->unit = unit;
+    victim->track = track;
+    victim->valid = 0;
+    victim->lastUse = cacheClock++;
+    return victim;
 }
 
-static void 
-WriteStub(USLOSS_Sysargs *sysargs) 
+/*
+ * CacheRead
+ *
+ * Copies the sectors of a read from the cache into buffer if they are all cached. Returns TRUE
+ * if it did. Called with the lock held.
+ */
+static int 
+CacheRead(int unit, int first, int sectors, char *buffer)
 {
-    int     rc;
-    rc = P2_DiskWrite((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, sysargs->arg1);
-    sysargs->arg4 = (void *) rc;
-}
+    int i;
 
+    for (i = 0; i < sectors; i++) {
+        int track = (first + i) / USLOSS_DISK_TRACK_SIZE;
+        int sector = (first + i) % USLOSS_DISK_TRACK_SIZE;
+        CacheEntry *entry = CacheFind(unit, track, FALSE, FALSE);
+        if (entry == NULL || !(entry->valid & (1 << sector))) {
+            cacheInfo.misses++;
+            return FALSE;
+        }
+    }
+    for (i = 0; i < sectors; i++) {
+        int track = (first + i) / USLOSS_DISK_TRACK_SIZE;
+        int sector = (first + i) % USLOSS_DISK_TRACK_SIZE;
+        CacheEntry *entry = CacheFind(unit, track, FALSE, FALSE);
+        memcpy(buffer + i * USLOSS_DISK_SECTOR_SIZE, entry->data[sector], USLOSS_DISK_SECTOR_SIZE);
+    }
+    cacheInfo.hits++;
+    return TRUE;
+}
 
-static void 
-SizeStub(USLOSS_Sysargs *sysargs) 
+/*
+ * CacheStore
+ *
+ * Puts a sector that was just read or written into the cache. Returns FALSE if there was no
+ * room for it. Called without the lock held.
+ */
+static int 
+CacheStore(int unit, int track, int sector, char *data, int replace)
 {
-    int     rc;
-    int     sector;
-    int     disk;
+    CacheEntry *entry;
 
-    rc = P2_DiskSize((int) sysargs->arg1, &sector, &disk);
-    sysargs->arg1 = (void *) sector;
-    sysargs->arg2 = (void *) disk;
-    sysargs->arg4 = (void *) rc;
+    if(P1_Lock(lockId));
+    entry = CacheFind(unit, track, TRUE, replace);
+    if (entry != NULL) {
+        memcpy(entry->data[sector], data, USLOSS_DISK_SECTOR_SIZE);
+        entry->valid |= 1 << sector;
+    }
+    if(P1_Unlock(lockId));
+    return entry != NULL;
 }
 
+/*
+ * Prefetch
+ *
+ * Reads the next track from the unit's manifest into the cache, a sector at a time, giving up
+ * on the rest of the track as soon as a request arrives. Prefetching ends for good when the
+ * cache is full. Called by the driver without holding the lock.
+ */
+static int 
+Prefetch(int unit, int track)
+{
+    char data[USLOSS_DISK_SECTOR_SIZE];
+    CacheEntry *entry;
+    int idle;
+    int cached;
+    int rc = P1_SUCCESS;
 
+    if (track >= numTracks[unit]) {
+        return rc;
+    }
+    for (int sector = 0; sector < USLOSS_DISK_TRACK_SIZE; sector++) {
+        if(P1_Lock(lockId));
+        idle = (depth[unit] == 0);
+        // make room before reading, so nothing is read that can't be kept
+        entry = idle ? CacheFind(unit, track, TRUE, FALSE) : NULL;
+        if (idle && (entry == NULL)) {
+            // budget used up
+            nextPrefetch[unit] = numPrefetch[unit];
+        }
+        cached = (entry != NULL) && (entry->valid & (1 << sector));
+        if(P1_Unlock(lockId));
+        if (entry == NULL) {
+            break;
+        }
+        if (cached) {
+            continue;
+        }
+        if (track != currentTrack[unit]) {
+            rc = DiskIO(unit, USLOSS_DISK_SEEK, (void *) track, NULL);
+            if (rc != P1_SUCCESS) {
+                break;
+            }
+            currentTrack[unit] = track;
+        }
+        rc = DiskIO(unit, USLOSS_DISK_READ, (void *) sector, data);
+        if (rc != P1_SUCCESS) {
+            break;
+        }
+        if(P1_Lock(lockId));
+        // the other unit may have replaced the entry while the sector was read
+        entry = CacheFind(unit, track, FALSE, FALSE);
+        if (entry != NULL) {
+            memcpy(entry->data[sector], data, USLOSS_DISK_SECTOR_SIZE);
+            entry->valid |= 1 << sector;
+            cacheInfo.prefetched++;
+        }
+        if(P1_Unlock(lockId));
+    }
+    return rc;
+}
+
+/*
+ * Perform
+ *
+ * Performs the read or write described by task, seeking across tracks as necessary. Called by
+ * the driver without holding the lock.
+ */
+static int 
+Perform(int unit, Pool *task)
+{
+    int rc = P1_SUCCESS;
+    int sector = task->first;
+    int track = task->track;
+    char *buffer = task->buffer;
+
+    if ((task->track < 0) || (task->track >= numTracks[unit])) {
+        return P2_INVALID_FIRST;
+    }
+    if (task->track * USLOSS_DISK_TRACK_SIZE + task->first + task->sectors >
+        numTracks[unit] * USLOSS_DISK_TRACK_SIZE) {
+        return P2_INVALID_SECTORS;
+    }
+    for (int i = 0; i < task->sectors; i++) {
+        if (sector == USLOSS_DISK_TRACK_SIZE) {
+            // nobody wants the rest if the process has terminated
+            if (task->cancelled) {
+                break;
+            }
+            track++;
+            sector = 0;
+        }
+        // seeks proper track if necessary
+        if (track != currentTrack[unit]) {
+            rc = DiskIO(unit, USLOSS_DISK_SEEK, (void *) track, NULL);
+            if (rc != P1_SUCCESS) {
+                break;
+            }
+            currentTrack[unit] = track;
+            heatmaps[unit][track].seeks++;
+        }
+        rc = DiskIO(unit, task->opr, (void *) sector, buffer + i * USLOSS_DISK_SECTOR_SIZE);
+        if (rc != P1_SUCCESS) {
+            break;
+        }
+        if (task->opr == USLOSS_DISK_READ) {
+            heatmaps[unit][track].reads++;
+        } else {
+            heatmaps[unit][track].writes++;
+        }
+        // the cache is write-through
+        CacheStore(unit, track, sector, buffer + i * USLOSS_DISK_SECTOR_SIZE, TRUE);
+        sector++;
+    }
+    return rc;
+}
+
+/*
+ * Average
+ *
+ * Returns the moving average after folding in a sample. The step is rounded away from zero so
+ * that a steady sample is reached exactly instead of the average settling short of it.
+ */
+static int 
+Average(int avg, int sample)
+{
+    int diff = sample - avg;
+
+    if (diff >= 0) {
+        return avg + (diff + AVG_WEIGHT - 1) / AVG_WEIGHT;
+    }
+    return avg - (AVG_WEIGHT - 1 - diff) / AVG_WEIGHT;
+}
+
+/*
+ * Adapt
+ *
+ * Folds the current queue into the moving averages and, in adaptive mode, switches the unit's
+ * policy if the averages have crossed a threshold. Called with the lock held.
+ */
+static void 
+Adapt(int unit, int queued, int distance)
+{
+    Sched *s = &sched[unit];
+    P2_DiskSchedInfo *info = &s->info;
+    P2_DiskPolicyEvent *event;
+    int policy;
+
+    info->avgDepth = Average(info->avgDepth, queued * SCALE);
+    if (queued > 0) {
+        info->avgSeek = Average(info->avgSeek, distance * SCALE / queued);
+    }
+    if (!s->adaptive) {
+        return;
+    }
+    if ((info->avgDepth < s->fcfsDepth * SCALE) || (info->avgSeek < s->minSeek * SCALE)) {
+        policy = P2_DISK_FCFS;
+    } else if (info->avgDepth < s->lookDepth * SCALE) {
+        policy = P2_DISK_SSTF;
+    } else {
+        policy = P2_DISK_LOOK;
+    }
+    if (policy != info->policy) {
+        event = &info->events[info->switches % P2_DISK_MAX_EVENTS];
+        event->time = CurrentTime();
+        event->from = info->policy;
+        event->to = policy;
+        event->avgDepth = info->avgDepth;
+        event->avgSeek = info->avgSeek;
+        info->switches++;
+        info->policy = policy;
+    }
+}
+
+/*
+ * Choose
+ *
+ * Returns the index in pools of the next request the unit should perform, or -1 if it has
+ * none. Called with the lock held.
+ */
+static int 
+Choose(int unit)
+{
+    Sched *s = &sched[unit];
+    int chosen = -1;
+    int best = 0;
+    int key;
+    int distance;
+    int queued = 0;
+    int total = 0; // sum of the queued requests' distances from the head
+
+    for (int pass = 0; pass < 2; pass++) {
+        chosen = -1;
+        queued = 0;
+        total = 0;
+        for (int i = 0; i < P1_MAXPROC; i++) {
+            // If there is nothing there go on to the next one
+            if (pools[i] == NULL || pools[i]->unit != unit || pools[i]->state != POOL_QUEUED) {
+                continue;
+            }
+            // Size requests need no seek at all
+            if (pools[i]->opr == USLOSS_DISK_TRACKS) {
+                pools[i]->policy = s->info.policy;
+                return i;
+            }
+            distance = abs(pools[i]->track - currentTrack[unit]);
+            queued++;
+            total += distance;
+            switch (s->info.policy) {
+                case P2_DISK_FCFS:
+                    key = pools[i]->seq;
+                    break;
+                case P2_DISK_LOOK:
+                    // only requests ahead of the head in the sweep direction
+                    if ((pools[i]->track - currentTrack[unit]) * s->direction < 0) {
+                        continue;
+                    }
+                    key = distance;
+                    break;
+                default:
+                    key = distance;
+                    break;
+            }
+            if (chosen == -1 || key < best) {
+                best = key;
+                chosen = i;
+            }
+        }
+        // LOOK reverses when nothing is left ahead of the head
+        if (chosen != -1 || queued == 0 || s->info.policy != P2_DISK_LOOK) {
+            break;
+        }
+        s->direction = -s->direction;
+    }
+    if (chosen != -1) {
+        pools[chosen]->policy = s->info.policy;
+        s->info.requests[s->info.policy]++;
+        s->info.sectors[s->info.policy] += pools[chosen]->sectors;
+        s->info.seeks[s->info.policy] += abs(pools[chosen]->track - currentTrack[unit]);
+        Adapt(unit, queued, total);
+    }
+    return chosen;
+}
+
+/*
+ * P2_DiskSetPolicy
+ *
+ * Sets the scheduling policy of a unit. P2_DISK_ADAPTIVE lets the driver pick the policy from
+ * the observed queue depth and seek distance; any other policy is used until changed.
+ */
+int 
+P2_DiskSetPolicy(int unit, int policy)
+{
+    if ((unit < 0) || (unit >= USLOSS_DISK_UNITS)) {
+        return P1_INVALID_UNIT;
+    }
+    if ((policy < 0) || (policy > P2_DISK_ADAPTIVE)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    if(P1_Lock(lockId));
+    sched[unit].adaptive = (policy == P2_DISK_ADAPTIVE);
+    if (policy != P2_DISK_ADAPTIVE) {
+        sched[unit].info.policy = policy;
+    }
+    if(P1_Unlock(lockId));
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskSetThresholds
+ *
+ * Sets the thresholds used in adaptive mode. Depths are in requests and minSeek is in tracks.
+ */
+int 
+P2_DiskSetThresholds(int unit, int fcfsDepth, int lookDepth, int minSeek)
+{
+    if ((unit < 0) || (unit >= USLOSS_DISK_UNITS)) {
+        return P1_INVALID_UNIT;
+    }
+    if ((fcfsDepth < 0) || (lookDepth < fcfsDepth) || (minSeek < 0)) {
+        return P2_INVALID_ARGUMENT;
+    }
+    if(P1_Lock(lockId));
+    sched[unit].fcfsDepth = fcfsDepth;
+    sched[unit].lookDepth = lookDepth;
+    sched[unit].minSeek = minSeek;
+    if(P1_Unlock(lockId));
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskSchedStats
+ *
+ * Copies the scheduling counters, averages and most recent policy changes of a unit.
+ */
+int 
+P2_DiskSchedStats(int unit, P2_DiskSchedInfo *info)
+{
+    if ((unit < 0) || (unit >= USLOSS_DISK_UNITS)) {
+        return P1_INVALID_UNIT;
+    }
+    if (info == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if(P1_Lock(lockId));
+    *info = sched[unit].info;
+    info->adaptive = sched[unit].adaptive;
+    if(P1_Unlock(lockId));
+    return P1_SUCCESS;
+}
+
+/*
+ * DiskDriver
+ *
+ * Kernel process that manages a disk device and services disk I/O requests from other processes.
+ * Note that it may require several disk operations to service a single I/O request. A disk
+ * operation is performed by sending a request of type USLOSS_DeviceRequest to the disk via
+ * USLOSS_DeviceOutput, then waiting for the operation to finish via P1_WaitDevice. The status
+ * returned by P1_WaitDevice will tell you if the operation was successful or not.
+ */
+
+static int 
+DiskDriver(void *arg) 
+{
+    int unit = (int) arg;
+    int rc;
+    int index; // index of pools with the chosen job
+    int tracks;
+    Pool *currentTask;
+    int start;
+    int track; // track to prefetch, -1 if none
+    /****
+    repeat
+        choose request according to the unit's scheduling policy
+        seek to proper track if necessary
+        while request isn't complete
+             for all sectors to be read/written in current track
+                read/write sector
+             seek to next track
+        wake the waiting process
+    until P2DiskShutdown has been called
+    ****/
+
+    // learn the size of the disk before serving anything
+    rc = DiskIO(unit, USLOSS_DISK_TRACKS, &tracks, NULL);
+    if(P1_Lock(lockId));
+    numTracks[unit] = (rc == P1_SUCCESS) ? tracks : 0;
+    heatmaps[unit] = calloc(numTracks[unit] + 1, sizeof(P2_TrackHeat));
+    assert(heatmaps[unit] != NULL);
+    if(P1_Unlock(lockId));
+
+    while(rc != P1_WAIT_ABORTED){
+        if(P1_Lock(lockId));
+        while(1){
+            index = Choose(unit);
+            track = -1;
+            if(index != -1 || shuttingDown){
+                break;
+            }
+            // nothing to do, so warm the cache
+            if(nextPrefetch[unit] < numPrefetch[unit]){
+                track = prefetch[unit][nextPrefetch[unit]++];
+                break;
+            }
+            if(P1_Wait(workCond[unit]));
+        }
+        if(track != -1){
+            if(P1_Unlock(lockId));
+            rc = Prefetch(unit, track);
+            continue;
+        }
+        if(index == -1){
+            if(P1_Unlock(lockId));
+            break;
+        }
+        currentTask = pools[index];
+        currentTask->state = POOL_ACTIVE;
+        if(P1_Unlock(lockId));
+
+        start = CurrentTime();
+        if(currentTask->opr == USLOSS_DISK_TRACKS){
+            rc = P1_SUCCESS;
+        } else {
+            rc = Perform(unit, currentTask);
+        }
+
+        // wake the waiting process and let a blocked submitter in
+        if(P1_Lock(lockId));
+        sched[unit].info.busy[currentTask->policy] += CurrentTime() - start;
+        currentTask->rc = rc;
+        currentTask->state = POOL_DONE;
+        depth[unit]--;
+        if(currentTask->cancelled){
+            // free the slot for the next process with this pid
+            pools[currentTask->pid] = NULL;
+        } else if (submitted[currentTask->pid]) {
+            P2EventNotify(P2_EVENT_DISK, currentTask->pid);
+        }
+        if(P1_Signal(currentTask->condId));
+        if(P1_Broadcast(roomCond[unit]));
+        if(P1_Unlock(lockId));
+    }
+    USLOSS_Console("DiskDriver PID %d unit %d exiting.\n", P1_GetPid(), unit);
+    return 0;
+}
+
+/*
+ * DiskExit
+ *
+ * Called by P2_Terminate. A request the process has queued is withdrawn at once; one that is
+ * being performed stops at the next track boundary and is not reported to anyone.
+ */
+static void 
+DiskExit(int pid)
+{
+    Pool *task;
+
+    if(P1_Lock(lockId));
+    task = pools[pid];
+    if (task != NULL) {
+        if (task->state == POOL_QUEUED) {
+            pools[pid] = NULL;
+            depth[task->unit]--;
+            sched[task->unit].info.cancelled++;
+            if(P1_Broadcast(roomCond[task->unit]));
+        } else if (task->state == POOL_ACTIVE) {
+            task->cancelled = TRUE;
+            sched[task->unit].info.cancelled++;
+        } else {
+            // an asynchronous request that was never collected
+            pools[pid] = NULL;
+        }
+    }
+    submitted[pid] = FALSE;
+    if(P1_Unlock(lockId));
+}
+
+/*
+ * NextTicket
+ *
+ * Lets the next ticket holder on the unit in, skipping tickets whose holders timed out. Called
+ * with the lock held.
+ */
+static void 
+NextTicket(int unit)
+{
+    nowServing[unit]++;
+    while ((nowServing[unit] != nextTicket[unit]) && 
+           abandoned[unit][nowServing[unit] % P1_MAXPROC]) {
+        abandoned[unit][nowServing[unit] % P1_MAXPROC] = FALSE;
+        nowServing[unit]++;
+    }
+    if(P1_Broadcast(roomCond[unit]));
+}
+
+/*
+ * DiskExpire
+ *
+ * Called by the clock driver when the timeout of a process's request expires.
+ */
+static void 
+DiskExpire(int pid)
+{
+    Pool *task;
+
+    if(P1_Lock(lockId));
+    timedOut[pid] = TRUE;
+    task = pools[pid];
+    if (task != NULL) {
+        if(P1_Signal(task->condId));
+    } else {
+        // still waiting for admission, don't know which unit
+        for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+            if(P1_Broadcast(roomCond[unit]));
+        }
+    }
+    if(P1_Unlock(lockId));
+}
+
+/*
+ * Admit
+ *
+ * Admission control. Counts a new request on the unit, waiting for room if wait is TRUE.
+ * Called with the lock held.
+ */
+static int 
+Admit(int unit, int wait)
+{
+    int index = P1_GetPid();
+    int ticket;
+
+    if ((depth[unit] >= maxDepth[unit]) || (nextTicket[unit] != nowServing[unit])) {
+        if (!wait) {
+            return P2_DISK_BUSY;
+        }
+        ticket = nextTicket[unit]++;
+        while ((ticket != nowServing[unit]) || (depth[unit] >= maxDepth[unit])) {
+            if (timedOut[index]) {
+                if (ticket == nowServing[unit]) {
+                    NextTicket(unit);
+                } else {
+                    abandoned[unit][ticket % P1_MAXPROC] = TRUE;
+                }
+                sched[unit].info.timeouts++;
+                return P2_TIMEOUT;
+            }
+            if(P1_Wait(roomCond[unit]));
+        }
+        // the next ticket holder may also fit
+        NextTicket(unit);
+    }
+    depth[unit]++;
+    return P1_SUCCESS;
+}
+
+/*
+ * Enqueue
+ *
+ * Gives a request to the unit's device driver and, unless async is TRUE, waits until it
+ * completes. Called with the lock held. A request whose timeout expires before it is admitted or
+ * before the driver starts it is withdrawn and fails with P2_TIMEOUT; one that has started is
+ * allowed to finish.
+ */
+static int 
+Enqueue(int opr, int unit, int first, int sectors, void *buffer, int wait, int async)
+{
+    int index = P1_GetPid();
+    int cached = FALSE;
+    int rc;
+    Pool *task;
+
+    if (submitted[index]) {
+        // its asynchronous request still holds its entry
+        return P2_DISK_BUSY;
+    }
+    if ((opr == USLOSS_DISK_READ) && CacheRead(unit, first, sectors, buffer)) {
+        if (!async) {
+            return P1_SUCCESS;
+        }
+        cached = TRUE;
+    } else {
+        rc = Admit(unit, wait);
+        if (rc != P1_SUCCESS) {
+            return rc;
+        }
+    }
+
+    // a cancelled request of a previous process with this pid may still be in progress
+    while (pools[index] != NULL) {
+        if(P1_Wait(condIds[index]));
+    }
+    task = &entries[index];
+    task->opr = opr;
+    task->first = first % USLOSS_DISK_TRACK_SIZE;
+    task->sectors = sectors;
+    task->unit = unit;
+    task->track = first / USLOSS_DISK_TRACK_SIZE;
+    task->buffer = buffer;
+    task->condId = condIds[index];
+    task->state = POOL_QUEUED;
+    task->rc = P1_SUCCESS;
+    task->seq = arrivals[unit]++;
+    task->pid = index;
+    task->cancelled = FALSE;
+    if (cached) {
+        // nothing for the driver to do
+        task->state = POOL_DONE;
+        submitted[index] = TRUE;
+        return P1_SUCCESS;
+    }
+    pools[index] = task;
+    if(P1_Signal(workCond[unit]));
+    if (async) {
+        submitted[index] = TRUE;
+        return P1_SUCCESS;
+    }
+
+    // wait until device driver completes the request
+    while (task->state != POOL_DONE) {
+        if (timedOut[index] && (task->state == POOL_QUEUED)) {
+            // withdraw it
+            pools[index] = NULL;
+            depth[unit]--;
+            sched[unit].info.timeouts++;
+            if(P1_Broadcast(roomCond[unit]));
+            return P2_TIMEOUT;
+        }
+        if(P1_Wait(task->condId));
+    }
+    rc = task->rc;
+    pools[index] = NULL;
+    return rc;
+}
+
+/*
+ * Submit
+ *
+ * Validates a request and passes it to Enqueue. If wait is FALSE and the unit has no room,
+ * returns P2_DISK_BUSY instead of blocking for admission. If timeout isn't -1 the request is
+ * withdrawn after that many milliseconds unless the driver has started it. If ticket isn't NULL
+ * the request is asynchronous: Submit returns once it is queued and puts its ticket in *ticket.
+ */
+static int 
+Submit(int opr, int unit, int first, int sectors, void *buffer, int wait, int timeout, 
+       int *ticket)
+{
+    P2_ProcUsage *usage;
+    int start;
+    int rc;
+
+    // validate parameters
+    if ((unit < 0) || (unit >= USLOSS_DISK_UNITS)) {
+        return P1_INVALID_UNIT;
+    }
+    if (opr != USLOSS_DISK_TRACKS) {
+        if (first < 0) {
+            return P2_INVALID_FIRST;
+        }
+        if (sectors <= 0) {
+            return P2_INVALID_SECTORS;
+        }
+        if (buffer == NULL) {
+            return P2_NULL_ADDRESS;
+        }
+    }
+    if (timeout < -1) {
+        return P2_INVALID_ARGUMENT;
+    }
+
+    timedOut[P1_GetPid()] = FALSE;
+    if (timeout != -1) {
+        P2TimeoutStart(timeout, DiskExpire);
+    }
+    start = CurrentTime();
+    if(P1_Lock(lockId));
+    rc = Enqueue(opr, unit, first, sectors, buffer, wait, ticket != NULL);
+    if(P1_Unlock(lockId));
+    if (timeout != -1) {
+        P2TimeoutCancel();
+    }
+
+    // charge the caller
+    usage = P2ProcAccount(P1_GetPid());
+    usage->diskTime += CurrentTime() - start;
+    if (ticket != NULL) {
+        // sectors are charged when the result is collected
+        if (rc == P1_SUCCESS) {
+            *ticket = P1_GetPid();
+        }
+    } else if (rc == P1_SUCCESS) {
+        if (opr == USLOSS_DISK_READ) {
+            usage->sectorsRead += sectors;
+        } else if (opr == USLOSS_DISK_WRITE) {
+            usage->sectorsWritten += sectors;
+        }
+    }
+    return rc;
+}
+
+/*
+ * P2_DiskRead
+ *
+ * Reads the specified number of sectors from the disk starting at the first sector.
+ * First is the first sector that wants to be read, sectors is the amount of sectors
+ * wanted to be read starting at first.
+ */
+int 
+P2_DiskRead(int unit, int first, int sectors, void *buffer) 
+{
+    return Submit(USLOSS_DISK_READ, unit, first, sectors, buffer, TRUE, -1, NULL);
+}
+
+/*
+ * P2_DiskWrite
+ *
+ * Writes the specified number of sectors to the disk starting at the first sector.
+ */
+int 
+P2_DiskWrite(int unit, int first, int sectors, void *buffer) 
+{
+    return Submit(USLOSS_DISK_WRITE, unit, first, sectors, buffer, TRUE, -1, NULL);
+}
+
+/*
+ * P2_DiskTryRead
+ *
+ * Like P2_DiskRead, but returns P2_DISK_BUSY immediately if the unit's queue is full.
+ */
+int 
+P2_DiskTryRead(int unit, int first, int sectors, void *buffer)
+{
+    return Submit(USLOSS_DISK_READ, unit, first, sectors, buffer, FALSE, -1, NULL);
+}
+
+/*
+ * P2_DiskTryWrite
+ *
+ * Like P2_DiskWrite, but returns P2_DISK_BUSY immediately if the unit's queue is full.
+ */
+int 
+P2_DiskTryWrite(int unit, int first, int sectors, void *buffer)
+{
+    return Submit(USLOSS_DISK_WRITE, unit, first, sectors, buffer, FALSE, -1, NULL);
+}
+
+/*
+ * P2_DiskReadTimed
+ *
+ * Like P2_DiskRead, but returns P2_TIMEOUT if the read hasn't started within timeoutMs
+ * milliseconds.
+ */
+int 
+P2_DiskReadTimed(int unit, int first, int sectors, void *buffer, int timeoutMs)
+{
+    if (timeoutMs < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    return Submit(USLOSS_DISK_READ, unit, first, sectors, buffer, TRUE, timeoutMs, NULL);
+}
+
+/*
+ * P2_DiskWriteTimed
+ *
+ * Like P2_DiskWrite, but returns P2_TIMEOUT if the write hasn't started within timeoutMs
+ * milliseconds.
+ */
+int 
+P2_DiskWriteTimed(int unit, int first, int sectors, void *buffer, int timeoutMs)
+{
+    if (timeoutMs < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    return Submit(USLOSS_DISK_WRITE, unit, first, sectors, buffer, TRUE, timeoutMs, NULL);
+}
+
+/*
+ * P2_DiskReadAsync
+ *
+ * Like P2_DiskTryRead, but returns as soon as the read is queued and puts its ticket in *ticket.
+ * The P2_EVENT_DISK event with that id happens when it finishes, and P2_DiskCollect returns its
+ * result. Fails with P2_DISK_BUSY if the caller has a request it hasn't collected.
+ */
+int 
+P2_DiskReadAsync(int unit, int first, int sectors, void *buffer, int *ticket)
+{
+    if (ticket == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    return Submit(USLOSS_DISK_READ, unit, first, sectors, buffer, FALSE, -1, ticket);
+}
+
+/*
+ * P2_DiskWriteAsync
+ *
+ * Like P2_DiskReadAsync, but for a write. The buffer must not be changed until the write is
+ * collected.
+ */
+int 
+P2_DiskWriteAsync(int unit, int first, int sectors, void *buffer, int *ticket)
+{
+    if (ticket == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    return Submit(USLOSS_DISK_WRITE, unit, first, sectors, buffer, FALSE, -1, ticket);
+}
+
+/*
+ * P2_DiskCollect
+ *
+ * Puts the result of the caller's asynchronous request in *status and frees its entry. Returns
+ * P2_WOULD_BLOCK if the request hasn't finished, and P2_INVALID_ARGUMENT if the caller has no
+ * request with that ticket.
+ */
+int 
+P2_DiskCollect(int ticket, int *status)
+{
+    int index = P1_GetPid();
+    P2_ProcUsage *usage;
+    Pool *task = &entries[index];
+    int rc = P1_SUCCESS;
+
+    if (status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (ticket != index) {
+        return P2_INVALID_ARGUMENT;
+    }
+    if(P1_Lock(lockId));
+    if (!submitted[index]) {
+        rc = P2_INVALID_ARGUMENT;
+    } else if (task->state != POOL_DONE) {
+        rc = P2_WOULD_BLOCK;
+    } else {
+        *status = task->rc;
+        pools[index] = NULL;
+        submitted[index] = FALSE;
+    }
+    if(P1_Unlock(lockId));
+
+    if ((rc == P1_SUCCESS) && (*status == P1_SUCCESS)) {
+        usage = P2ProcAccount(index);
+        if (task->opr == USLOSS_DISK_READ) {
+            usage->sectorsRead += task->sectors;
+        } else {
+            usage->sectorsWritten += task->sectors;
+        }
+    }
+    return rc;
+}
+
+/*
+ * DiskReady
+ *
+ * Event source for P2_EVENT_DISK. The asynchronous request with the ticket has finished.
+ */
+static int 
+DiskReady(int ticket)
+{
+    int ready;
+
+    if ((ticket < 0) || (ticket >= P1_MAXPROC)) {
+        return TRUE;
+    }
+    if(P1_Lock(lockId));
+    ready = !submitted[ticket] || (entries[ticket].state == POOL_DONE);
+    if(P1_Unlock(lockId));
+    return ready;
+}
+
+/*
+ * P2_DiskSize
+ *
+ * Returns the size of the disk.
+ */
+int 
+P2_DiskSize(int unit, int *sector, int *disk) 
+{
+    int rc;
+
+    // validate parameter
+    if ((sector == NULL) || (disk == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    // goes through the driver so that the size is known when it completes
+    rc = Submit(USLOSS_DISK_TRACKS, unit, 0, 0, NULL, TRUE, -1, NULL);
+    if (rc == P1_SUCCESS) {
+        *disk = numTracks[unit] * USLOSS_DISK_TRACK_SIZE;
+        *sector = USLOSS_DISK_SECTOR_SIZE;
+    }
+    return rc;
+}
+
+/*
+ * P2_DiskSetHeatmapFile
+ *
+ * Makes P2DiskShutdown write the heatmaps of all units to path as CSV. The path must stay valid
+ * until then. It starts out NULL, which writes nothing.
+ */
+int 
+P2_DiskSetHeatmapFile(char *path)
+{
+    if(P1_Lock(lockId));
+    heatmapFile = path;
+    if(P1_Unlock(lockId));
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskHeatmap
+ *
+ * Copies up to *tracks per-track access counts of the unit into heat, and sets *tracks to the
+ * size of the disk in tracks.
+ */
+int 
+P2_DiskHeatmap(int unit, P2_TrackHeat *heat, int *tracks)
+{
+    int rc;
+    int sector;
+    int size;
+
+    if ((heat == NULL) || (tracks == NULL)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (*tracks < 0) {
+        return P2_INVALID_ARGUMENT;
+    }
+    // makes sure the driver knows the size of the disk
+    rc = P2_DiskSize(unit, &sector, &size);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    if(P1_Lock(lockId));
+    if (*tracks > numTracks[unit]) {
+        *tracks = numTracks[unit];
+    }
+    memcpy(heat, heatmaps[unit], *tracks * sizeof(P2_TrackHeat));
+    if(P1_Unlock(lockId));
+    *tracks = numTracks[unit];
+    return P1_SUCCESS;
+}
+
+static void 
+ReadStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    rc = P2_DiskRead((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+WriteStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    rc = P2_DiskWrite((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, sysargs->arg1);
+    sysargs->arg4 = (void *) rc;
+}
+
+
+static void 
+SizeStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    int     sector;
+    int     disk;
+
+    rc = P2_DiskSize((int) sysargs->arg1, &sector, &disk);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) sector;
+        sysargs->arg2 = (void *) disk;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+HeatmapStub(USLOSS_Sysargs *sysargs)
+{
+    int     rc;
+    int     tracks = (int) sysargs->arg3;
+
+    rc = P2_DiskHeatmap((int) sysargs->arg1, sysargs->arg2, &tracks);
+    sysargs->arg3 = (void *) tracks;
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+ReadTimedStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    rc = P2_DiskReadTimed((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, 
+                          sysargs->arg1, (int) sysargs->arg5);
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+WriteTimedStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    rc = P2_DiskWriteTimed((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, 
+                           sysargs->arg1, (int) sysargs->arg5);
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+ReadAsyncStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    int     ticket;
+
+    rc = P2_DiskReadAsync((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, 
+                          sysargs->arg1, &ticket);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) ticket;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+WriteAsyncStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    int     ticket;
+
+    rc = P2_DiskWriteAsync((int) sysargs->arg4, (int) sysargs->arg3, (int) sysargs->arg2, 
+                           sysargs->arg1, &ticket);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) ticket;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+CollectStub(USLOSS_Sysargs *sysargs) 
+{
+    int     rc;
+    int     status;
+
+    rc = P2_DiskCollect((int) sysargs->arg1, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
@@ -0,0 +1,140 @@
+/*
+ * Tests admission control on a disk unit. The queue depth of unit 0 is limited to one request.
+ * While a Writer's request is outstanding P2_DiskTryWrite must fail with P2_DISK_BUSY, and
+ * blocked P2_DiskWrite callers must be admitted in the order they arrived, even though shortest
+ * seek first would prefer the later one. Unit 1 is unaffected by the limit on unit 0.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+static int passed = FALSE;
+
+#define NUMSECTORS 20
+#define UNIT 0
+#define TRACKS 100
+
+#define LOCK(lid) { \
+    int _rc = P1_Lock(lid); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+#define UNLOCK(lid) { \
+    int _rc = P1_Unlock(lid); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+static int order[10]; // order in which the requests were processed.
+static int finished = 0;       // # of finished requests
+static int lock;                // lock for above variables
+static char buffer[NUMSECTORS * USLOSS_DISK_SECTOR_SIZE];
+
+int Worker(void *arg)
+{
+    int first = (int) arg;
+
+    int rc = P2_DiskWrite(UNIT, first, NUMSECTORS, buffer);
+    TEST_RC(rc, P1_SUCCESS);
+
+    LOCK(lock);
+    order[finished++] = first;
+    UNLOCK(lock);
+    return 50;
+}
+
+// the first request is admitted, the others block in this order
+static int firsts[] = {0, 1345, 115};
+static int numWorkers = sizeof(firsts) / sizeof(int);
+
+int Controller(void *arg) {
+
+    int rc;
+    int pid;
+    int status;
+
+    for (int i = 0; i < numWorkers; i++) {
+        rc = P1_Fork(MakeName("Worker", i), Worker, (void *) firsts[i],
+                          4*USLOSS_MIN_STACK, 3, &pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+
+    // unit 0 is full, unit 1 is not
+    rc = P2_DiskTryWrite(UNIT, 500, 1, buffer);
+    TEST_RC(rc, P2_DISK_BUSY);
+    rc = P2_DiskTryRead(UNIT, 500, 1, buffer);
+    TEST_RC(rc, P2_DISK_BUSY);
+    rc = P2_DiskTryWrite(1, 500, 1, buffer);
+    TEST_RC(rc, P1_SUCCESS);
+
+    for (int i = 0; i < numWorkers; i++) {
+        rc = P1_Join(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(status, 50);
+    }
+
+    // blocked writers were admitted in FIFO order
+    TEST(finished, numWorkers);
+    for (int i = 0; i < finished; i++) {
+        TEST(order[i], firsts[i]);
+    }
+
+    // unit 0 is idle again
+    rc = P2_DiskTryRead(UNIT, 500, 1, buffer);
+    TEST_RC(rc, P1_SUCCESS);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_DiskSetQueueDepth(UNIT, 0);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_DiskSetQueueDepth(USLOSS_DISK_UNITS, 1);
+    TEST_RC(rc, P1_INVALID_UNIT);
+    rc = P2_DiskSetQueueDepth(UNIT, 1);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_LockCreate("Worker Lock", &lock);
+    TEST_RC(rc, P1_SUCCESS);
+    memset(buffer, 0xAD, sizeof(buffer));
+    rc = P1_Fork("Controller", Controller, NULL, 4*USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Join(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        rc = Disk_Create(NULL, i, TRACKS);
+        assert(rc == 0);
+    }
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+void finish(int argc, char **argv) {}
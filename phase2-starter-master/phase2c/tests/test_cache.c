@@ -0,0 +1,110 @@
+/*
+ * Tests the disk cache. It is off until given a budget. A track that was just written is read back
+ * from the cache, shrinking the cache drops the least recently used track, and P2DiskShutdown
+ * writes a manifest listing the hottest tracks that fit in the cache.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+#define TRACKS 10
+#define UNIT 0
+
+static int passed = FALSE;
+static char output[USLOSS_DISK_TRACK_SIZE * USLOSS_DISK_SECTOR_SIZE];
+static char input[USLOSS_DISK_TRACK_SIZE * USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc;
+    P2_DiskCacheInfo info;
+
+    P2ClockInit();
+    P2DiskInit();
+
+    // the cache is off until it is given a budget
+    rc = P2_DiskCacheStats(&info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.budget, 0);
+    rc = P2_DiskSetCacheBudget(P2_DISK_CACHE_TRACKS + 1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_DiskSetCacheBudget(P2_DISK_CACHE_TRACKS);
+    TEST_RC(rc, P1_SUCCESS);
+
+    memset(output, 0x5A, sizeof(output));
+    for (int i = 0; i < 2; i++) {
+        rc = P2_DiskWrite(UNIT, 5 * USLOSS_DISK_TRACK_SIZE, USLOSS_DISK_TRACK_SIZE, output);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = P2_DiskWrite(UNIT, USLOSS_DISK_TRACK_SIZE, 1, output);
+    TEST_RC(rc, P1_SUCCESS);
+
+    // track 5 is cached
+    rc = P2_DiskRead(UNIT, 5 * USLOSS_DISK_TRACK_SIZE, USLOSS_DISK_TRACK_SIZE, input);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(memcmp(input, output, sizeof(input)), 0);
+
+    // track 1 was used least recently so it is dropped
+    rc = P2_DiskSetCacheBudget(1);
+    TEST_RC(rc, P1_SUCCESS);
+    memset(input, 0, sizeof(input));
+    rc = P2_DiskRead(UNIT, USLOSS_DISK_TRACK_SIZE, 1, input);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(memcmp(input, output, USLOSS_DISK_SECTOR_SIZE), 0);
+
+    rc = P2_DiskCacheStats(&info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.budget, 1);
+    TEST(info.used, 1);
+    TEST(info.hits, 1);
+    TEST(info.misses, 1);
+    TEST(info.prefetched, 0);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    unlink(P2_DISK_MANIFEST);
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    int unit = -1, track = -1;
+    FILE *f;
+
+    DeleteAllDisks();
+    // only the hottest track fits in the cache
+    f = fopen(P2_DISK_MANIFEST, "r");
+    if ((f == NULL) || (fscanf(f, "%d %d", &unit, &track) != 2) || (unit != UNIT) ||
+        (track != 5) || (fscanf(f, "%d %d", &unit, &track) != EOF)) {
+        USLOSS_Console("%s is wrong.\n", P2_DISK_MANIFEST);
+        passed = FALSE;
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+    unlink(P2_DISK_MANIFEST);
+    if (passed) {
+        PASSED();
+    }
+}
+void finish(int argc, char **argv) {}
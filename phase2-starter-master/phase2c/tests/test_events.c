@@ -0,0 +1,206 @@
+/*
+ * Tests waiting for events of different kinds at once. P3_Startup starts an asynchronous write,
+ * a periodic timer and a Sender that exits after sending a message, then waits for all four with
+ * Sys_WaitEvents. Every event reported ready must be collected without blocking, and the timer,
+ * whose period is longest, must come last. An asynchronous read of the written sectors must
+ * return what was written.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+#define UNIT 0
+#define TRACKS 10
+#define SECTORS 3
+#define SLEEP 50
+#define PERIOD 500
+
+static char buffer[SECTORS * USLOSS_DISK_SECTOR_SIZE];
+static char copy[SECTORS * USLOSS_DISK_SECTOR_SIZE];
+static int message = 42;
+
+int Sender(void *arg)
+{
+    int mbox = (int) arg;
+    int rc;
+
+    rc = Sys_SleepMs(SLEEP);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxSend(mbox, &message, sizeof(message));
+    TEST_RC(rc, P1_SUCCESS);
+    return 7;
+}
+
+int P3_Startup(void *arg)
+{
+    P2_Event events[4];
+    int seen[4] = {FALSE, FALSE, FALSE, FALSE};
+    void *received = NULL;
+    int rc, other, pid;
+    int timer = -1;
+    int expirations = 0;
+    int mbox = -1;
+    int ticket = -1;
+    int size = 0;
+    int status = 0;
+    int ready = 0;
+    int left = 4;
+
+    events[0].type = P2_EVENT_TYPES;
+    events[0].id = 0;
+    rc = Sys_WaitEvents(events, 1, &ready);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = Sys_WaitEvents(events, 0, &ready);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    memset(buffer, 0x5A, sizeof(buffer));
+    rc = Sys_DiskWriteAsync(buffer, 0, SECTORS, UNIT, &ticket);
+    TEST_RC(rc, P1_SUCCESS);
+    // one outstanding request per process
+    rc = Sys_DiskWriteAsync(buffer, 0, SECTORS, UNIT, &other);
+    TEST_RC(rc, P2_DISK_BUSY);
+    rc = Sys_DiskCollect(ticket + 1, &status);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    rc = Sys_TimerCreate(PERIOD, &timer);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_MailboxCreate(1, &mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Sender", Sender, (void *) mbox, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    events[0].type = P2_EVENT_CHILD;
+    events[0].id = -1;
+    events[1].type = P2_EVENT_MBOX_RECV;
+    events[1].id = mbox;
+    events[2].type = P2_EVENT_DISK;
+    events[2].id = ticket;
+    events[3].type = P2_EVENT_TIMER;
+    events[3].id = timer;
+    while (left > 0) {
+        P2_Event waiting[4];
+        int index[4];
+        int count = 0;
+
+        // wait only for what hasn't happened yet
+        for (int i = 0; i < 4; i++) {
+            if (!seen[i]) {
+                index[count] = i;
+                waiting[count++] = events[i];
+            }
+        }
+        rc = Sys_WaitEvents(waiting, count, &ready);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(ready > 0, 1);
+        for (int i = 0; i < count; i++) {
+            if (!waiting[i].ready) {
+                continue;
+            }
+            ready--;
+            seen[index[i]] = TRUE;
+            left--;
+            switch (waiting[i].type) {
+                case P2_EVENT_CHILD:
+                    rc = Sys_WaitNoHang(&pid, &status);
+                    TEST_RC(rc, P1_SUCCESS);
+                    TEST(pid != -1, 1);
+                    TEST(status, 7);
+                    break;
+                case P2_EVENT_MBOX_RECV:
+                    rc = Sys_MailboxCondReceive(mbox, &received, &size);
+                    TEST_RC(rc, P1_SUCCESS);
+                    TEST(received == &message, 1);
+                    TEST(size, sizeof(message));
+                    break;
+                case P2_EVENT_DISK:
+                    rc = Sys_DiskCollect(ticket, &status);
+                    TEST_RC(rc, P1_SUCCESS);
+                    TEST_RC(status, P1_SUCCESS);
+                    break;
+                case P2_EVENT_TIMER:
+                    // the slowest source
+                    TEST(left, 0);
+                    rc = Sys_TimerWait(timer, &expirations);
+                    TEST_RC(rc, P1_SUCCESS);
+                    TEST(expirations >= 1, 1);
+                    break;
+            }
+        }
+        TEST(ready, 0);
+    }
+    rc = Sys_DiskCollect(ticket, &status);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    // read it back
+    rc = Sys_DiskReadAsync(copy, 0, SECTORS, UNIT, &ticket);
+    TEST_RC(rc, P1_SUCCESS);
+    events[0].type = P2_EVENT_DISK;
+    events[0].id = ticket;
+    rc = Sys_WaitEvents(events, 1, &ready);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(ready, 1);
+    rc = Sys_DiskCollect(ticket, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST_RC(status, P1_SUCCESS);
+    TEST(memcmp(buffer, copy, sizeof(buffer)), 0);
+
+    // a released mailbox doesn't keep anyone waiting
+    rc = Sys_MailboxRelease(mbox);
+    TEST_RC(rc, P1_SUCCESS);
+    events[0].type = P2_EVENT_MBOX_RECV;
+    events[0].id = mbox;
+    rc = Sys_WaitEvents(events, 1, &ready);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(events[0].ready, TRUE);
+    rc = Sys_TimerDelete(timer);
+    TEST_RC(rc, P1_SUCCESS);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,153 @@
+/*
+ * Tests that the disk request of a process that terminates is dropped. Unit 0 is limited to two
+ * requests. P3_Startup keeps the driver busy with a long asynchronous write while a Quitter
+ * queues a write and terminates without collecting it. The Quitter's request must be withdrawn
+ * before the driver reaches it, so its sector keeps its old contents, and must be counted as
+ * cancelled. Its slot must be returned to admission control, so a Writer spawned afterwards can
+ * still queue a write while P3_Startup's is outstanding.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+#define UNIT 0
+#define TRACKS 10
+#define LONG (3 * USLOSS_DISK_TRACK_SIZE)       // sectors in P3_Startup's write
+#define DROPPED (8 * USLOSS_DISK_TRACK_SIZE)    // sector the Quitter writes
+#define WRITTEN (9 * USLOSS_DISK_TRACK_SIZE)    // sector the Writer writes
+
+static char buffer[LONG * USLOSS_DISK_SECTOR_SIZE];
+static char mark[USLOSS_DISK_SECTOR_SIZE];
+static char copy[USLOSS_DISK_SECTOR_SIZE];
+
+/*
+ * Collect
+ *
+ * Waits for the asynchronous request with the ticket to finish and returns its status.
+ */
+static int Collect(int ticket)
+{
+    P2_Event event;
+    int rc;
+    int ready = 0;
+    int status = -1;
+
+    event.type = P2_EVENT_DISK;
+    event.id = ticket;
+    rc = Sys_WaitEvents(&event, 1, &ready);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(ready, 1);
+    rc = Sys_DiskCollect(ticket, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    return status;
+}
+
+// terminates with its write still queued behind P3_Startup's
+int Quitter(void *arg)
+{
+    int rc;
+    int ticket = -1;
+
+    rc = Sys_DiskWriteAsync(mark, DROPPED, 1, UNIT, &ticket);
+    TEST_RC(rc, P1_SUCCESS);
+    return 9;
+}
+
+int Writer(void *arg)
+{
+    int rc;
+    int ticket = -1;
+
+    // the unit would be full if the Quitter's request still counted
+    rc = Sys_DiskWriteAsync(mark, WRITTEN, 1, UNIT, &ticket);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST_RC(Collect(ticket), P1_SUCCESS);
+    return 10;
+}
+
+int P3_Startup(void *arg)
+{
+    int rc, pid;
+    int ticket = -1;
+    int status = -1;
+
+    memset(buffer, 0x11, sizeof(buffer));
+    memset(mark, 0x77, sizeof(mark));
+    rc = Sys_DiskWriteAsync(buffer, 0, LONG, UNIT, &ticket);
+    TEST_RC(rc, P1_SUCCESS);
+
+    // both run as soon as they are spawned, while the driver performs the long write
+    rc = Sys_Spawn("Quitter", Quitter, NULL, USLOSS_MIN_STACK, 1, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_WaitPid(pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 9);
+    rc = Sys_Spawn("Writer", Writer, NULL, USLOSS_MIN_STACK, 1, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_WaitPid(pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 10);
+    TEST_RC(Collect(ticket), P1_SUCCESS);
+
+    rc = Sys_DiskRead(copy, DROPPED, 1, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(memcmp(copy, mark, sizeof(copy)) != 0, 1);
+    rc = Sys_DiskRead(copy, WRITTEN, 1, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(memcmp(copy, mark, sizeof(copy)), 0);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    P2_DiskSchedInfo info;
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_DiskSetQueueDepth(UNIT, 2);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+    rc = P2_DiskSchedStats(UNIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.cancelled, 1);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,117 @@
+/*
+ * Tests the per-track heatmap. P3_Startup writes 20 sectors starting at sector 8, so 8 land on
+ * track 0 and 12 on track 1, then reads one sector on track 2. The head starts on track 0, so
+ * only tracks 1 and 2 are seeked to. The counts are checked through Sys_DiskHeatmap and in the
+ * CSV file P2DiskShutdown writes once P2_DiskSetHeatmapFile has asked for it.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+#define TRACKS 10
+#define UNIT 0
+
+static int passed = FALSE;
+static char buffer[20 * USLOSS_DISK_SECTOR_SIZE];
+
+int P3_Startup(void *arg) {
+    P2_TrackHeat heat[TRACKS];
+    int tracks = TRACKS;
+    int rc;
+
+    rc = Sys_DiskWrite(buffer, 8, 20, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_DiskRead(buffer, 40, 1, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = Sys_DiskHeatmap(UNIT, heat, &tracks);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(tracks, TRACKS);
+    TEST(heat[0].writes, 8);
+    TEST(heat[0].seeks, 0);
+    TEST(heat[1].writes, 12);
+    TEST(heat[1].seeks, 1);
+    TEST(heat[2].reads, 1);
+    TEST(heat[2].seeks, 1);
+    TEST(heat[3].reads + heat[3].writes + heat[3].seeks, 0);
+
+    // a short buffer gets a prefix of the map
+    tracks = 1;
+    rc = Sys_DiskHeatmap(UNIT, heat, &tracks);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(tracks, TRACKS);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid = -1, status = 0, p3Pid = -2;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_DiskSetHeatmapFile(P2_DISK_HEATMAP);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &p3Pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    unlink(P2_DISK_HEATMAP);
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    static char *expected[] = {
+        "unit,track,reads,writes,seeks\n",
+        "0,0,0,8,0\n",
+        "0,1,0,12,1\n",
+        "0,2,1,0,1\n",
+    };
+    char line[100];
+    FILE *f;
+
+    DeleteAllDisks();
+    f = fopen(P2_DISK_HEATMAP, "r");
+    if (f == NULL) {
+        USLOSS_Console("diskheat.csv is missing.\n");
+        passed = FALSE;
+    } else {
+        for (int i = 0; i < sizeof(expected) / sizeof(char *); i++) {
+            if ((fgets(line, sizeof(line), f) == NULL) || (strcmp(line, expected[i]) != 0)) {
+                USLOSS_Console("diskheat.csv line %d is wrong.\n", i + 1);
+                passed = FALSE;
+                break;
+            }
+        }
+        fclose(f);
+    }
+    if (passed) {
+        PASSED();
+    }
+}
+void finish(int argc, char **argv) {}
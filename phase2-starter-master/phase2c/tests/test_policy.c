@@ -0,0 +1,187 @@
+/*
+ * Tests the disk scheduling policies. The Controller creates several workers that write
+ * NUMSECTORS sectors starting at the sectors in the "firsts" array. The first request keeps the
+ * driver busy while the rest are submitted, so the order in which the remaining requests are
+ * performed is decided by the policy: LOOK sweeps up from the first request then back down,
+ * FCFS performs them in arrival order. Finally the unit is put in adaptive mode with thresholds
+ * that favor FCFS, and the statistics must show the switch from the default SSTF. Last, a run of
+ * one-at-a-time requests must bring the average depth to exactly 1 and, with a FCFS threshold of
+ * 1, switch the unit to SSTF.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+static int passed = FALSE;
+
+#define NUMSECTORS 20
+#define UNIT 0
+#define TRACKS 100
+#define SEQUENTIAL 64 // enough for the average depth to settle
+
+#define LOCK(lid) { \
+    int _rc = P1_Lock(lid); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+#define UNLOCK(lid) { \
+    int _rc = P1_Unlock(lid); \
+    assert(_rc == P1_SUCCESS); \
+}
+
+static int order[100]; // order in which the requests were processed.
+static int finished = 0;       // # of finished requests
+static int lock;                // lock for above variables
+
+int Worker(void *arg)
+{
+    int first = (int) arg;
+    char *buffer = malloc(NUMSECTORS * USLOSS_DISK_SECTOR_SIZE);
+    memset(buffer, 0xAD, NUMSECTORS * USLOSS_DISK_SECTOR_SIZE);
+
+    int rc = P2_DiskWrite(UNIT, first, NUMSECTORS, buffer);
+    TEST_RC(rc, P1_SUCCESS);
+
+    LOCK(lock);
+    order[finished++] = first;
+    UNLOCK(lock);
+    free(buffer);
+    return 50;
+}
+
+static int firsts[] = {800,1345,115,680,950,615};
+static int numWorkers = sizeof(firsts) / sizeof(int);
+static int lookOrder[] = {800,950,1345,680,615,115};
+
+static void
+RunWorkers(int *expected)
+{
+    int rc;
+    int pid;
+    int status;
+
+    finished = 0;
+    for (int i = 0; i < numWorkers; i++) {
+        rc = P1_Fork(MakeName("Worker", i), Worker, (void *) firsts[i],
+                          4*USLOSS_MIN_STACK, 3, &pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        rc = P1_Join(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        TEST(status, 50);
+    }
+    TEST(finished, numWorkers);
+    if (expected != NULL) {
+        for (int i = 0; i < finished; i++) {
+            TEST(order[i], expected[i]);
+        }
+    }
+}
+
+int Controller(void *arg) {
+
+    int rc;
+    char *buffer;
+    P2_DiskSchedInfo info;
+
+    rc = P2_DiskSetPolicy(UNIT, P2_DISK_ADAPTIVE + 1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    rc = P2_DiskSetPolicy(UNIT, P2_DISK_LOOK);
+    TEST_RC(rc, P1_SUCCESS);
+    RunWorkers(lookOrder);
+
+    rc = P2_DiskSetPolicy(UNIT, P2_DISK_FCFS);
+    TEST_RC(rc, P1_SUCCESS);
+    RunWorkers(firsts);
+
+    rc = P2_DiskSchedStats(UNIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.requests[P2_DISK_LOOK], numWorkers);
+    TEST(info.requests[P2_DISK_FCFS], numWorkers);
+    TEST(info.sectors[P2_DISK_FCFS], numWorkers * NUMSECTORS);
+    TEST(info.switches, 0);
+
+    // any average depth is below the FCFS threshold
+    rc = P2_DiskSetPolicy(UNIT, P2_DISK_SSTF);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_DiskSetThresholds(UNIT, 2, 1, 0);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+    rc = P2_DiskSetThresholds(UNIT, 100, 100, 0);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_DiskSetPolicy(UNIT, P2_DISK_ADAPTIVE);
+    TEST_RC(rc, P1_SUCCESS);
+    RunWorkers(NULL);
+
+    rc = P2_DiskSchedStats(UNIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.adaptive, TRUE);
+    TEST(info.policy, P2_DISK_FCFS);
+    TEST(info.switches, 1);
+    TEST(info.events[0].from, P2_DISK_SSTF);
+    TEST(info.events[0].to, P2_DISK_FCFS);
+
+    // one request at a time brings the average depth to exactly 1, which is not below a FCFS
+    // threshold of 1
+    rc = P2_DiskSetThresholds(UNIT, 1, 2, 0);
+    TEST_RC(rc, P1_SUCCESS);
+    buffer = malloc(USLOSS_DISK_SECTOR_SIZE);
+    memset(buffer, 0xAD, USLOSS_DISK_SECTOR_SIZE);
+    for (int i = 0; i < SEQUENTIAL; i++) {
+        rc = P2_DiskWrite(UNIT, 0, 1, buffer);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    free(buffer);
+    rc = P2_DiskSchedStats(UNIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.avgDepth, 1 * 100);
+    TEST(info.policy, P2_DISK_SSTF);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P1_LockCreate("Worker Lock", &lock);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_Fork("Controller", Controller, NULL, 4*USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Join(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+void finish(int argc, char **argv) {}
@@ -0,0 +1,139 @@
+/*
+ * Tests timed disk requests. The queue depth of unit 0 is limited to two requests. A Hog performs
+ * a long write; a timed write that finds the unit full gives up its place in the admission line,
+ * and one that is queued behind the Hog is withdrawn, both with P2_TIMEOUT. A blocking Writer that
+ * arrived after the timed-out caller must still be admitted. A timed read on an idle unit
+ * succeeds.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+
+static int passed = FALSE;
+
+#define HOGSECTORS (20 * USLOSS_DISK_TRACK_SIZE)
+#define UNIT 0
+#define TRACKS 100
+
+static char hogBuffer[HOGSECTORS * USLOSS_DISK_SECTOR_SIZE];
+static char buffer[USLOSS_DISK_SECTOR_SIZE];
+
+int Hog(void *arg)
+{
+    int rc = P2_DiskWrite(UNIT, 0, HOGSECTORS, hogBuffer);
+    TEST_RC(rc, P1_SUCCESS);
+    return 50;
+}
+
+int Queued(void *arg)
+{
+    // the Hog is active, so this is queued and withdrawn
+    int rc = P2_DiskWriteTimed(UNIT, 1500, 1, buffer, 0);
+    TEST_RC(rc, P2_TIMEOUT);
+    return 51;
+}
+
+int Blocked(void *arg)
+{
+    // the unit is full, so this waits for admission and gives up
+    int rc = P2_DiskWriteTimed(UNIT, 1510, 1, buffer, 0);
+    TEST_RC(rc, P2_TIMEOUT);
+    return 52;
+}
+
+int Writer(void *arg)
+{
+    // queued behind Blocked's abandoned ticket
+    int rc = P2_DiskWrite(UNIT, 1520, 1, buffer);
+    TEST_RC(rc, P1_SUCCESS);
+    return 53;
+}
+
+int Controller(void *arg) {
+
+    int rc;
+    int pid;
+    int status;
+    int total = 0;
+    P2_DiskSchedInfo info;
+
+    rc = P2_DiskReadTimed(UNIT, 0, 1, buffer, -1);
+    TEST_RC(rc, P2_INVALID_ARGUMENT);
+
+    // these block in the order they are forked
+    rc = P1_Fork("Hog", Hog, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_Fork("Queued", Queued, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_Fork("Blocked", Blocked, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P1_Fork("Writer", Writer, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+
+    for (int i = 0; i < 4; i++) {
+        rc = P1_Join(&pid, &status);
+        TEST_RC(rc, P1_SUCCESS);
+        total += status;
+    }
+    TEST(total, 50 + 51 + 52 + 53);
+
+    rc = P2_DiskSchedStats(UNIT, &info);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(info.timeouts, 2);
+
+    // an idle unit performs the request well before the timeout
+    rc = P2_DiskReadTimed(UNIT, 1520, 1, buffer, 1000);
+    TEST_RC(rc, P1_SUCCESS);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_DiskSetQueueDepth(UNIT, 2);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_DiskSetCacheBudget(0);
+    TEST_RC(rc, P1_SUCCESS);
+    memset(hogBuffer, 0xAD, sizeof(hogBuffer));
+    rc = P1_Fork("Controller", Controller, NULL, 4*USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Join(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    for (int i = 0; i < USLOSS_DISK_UNITS; i++) {
+        rc = Disk_Create(NULL, i, TRACKS);
+        assert(rc == 0);
+    }
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+void finish(int argc, char **argv) {}
@@ -0,0 +1,139 @@
+/*
+ * Tests per-process resource accounting. A Worker reads and writes the disk and sleeps, then
+ * exits. Its counters must still be available until P3_Startup waits for it, and gone after.
+ * P3_Startup's own system call count must go up by one per call, and by one for a whole batch.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2ext.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+#define UNIT 0
+#define TRACKS 10
+#define SLEEP 50
+
+static char buffer[3 * USLOSS_DISK_SECTOR_SIZE];
+
+int Worker(void *arg)
+{
+    int rc;
+
+    rc = Sys_DiskWrite(buffer, 0, 3, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_DiskRead(buffer, 0, 2, UNIT);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_SleepMs(SLEEP);
+    TEST_RC(rc, P1_SUCCESS);
+    return 42;
+}
+
+int P3_Startup(void *arg)
+{
+    P2_ProcUsage before, after, usage;
+    USLOSS_Sysargs calls[3];
+    int rc, pid, self;
+    int status = -1;
+    int done = 0;
+
+    rc = Sys_GetProcUsage(P1_MAXPROC, &usage);
+    TEST_RC(rc, P1_INVALID_PID);
+
+    rc = Sys_Spawn("Worker", Worker, NULL, USLOSS_MIN_STACK, 3, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    // long enough for the Worker to finish
+    rc = Sys_SleepMs(10 * SLEEP);
+    TEST_RC(rc, P1_SUCCESS);
+
+    rc = Sys_GetProcUsage(pid, &usage);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(usage.sectorsWritten, 3);
+    TEST(usage.sectorsRead, 2);
+    TEST(usage.diskTime > 0, 1);
+    TEST(usage.sleepTime >= SLEEP * 1000, 1);
+    // three calls and Sys_Terminate
+    TEST(usage.syscalls, 4);
+    TEST(usage.kernelTime >= 0, 1);
+    TEST(usage.userTime >= 0, 1);
+
+    rc = Sys_WaitPid(pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 42);
+    rc = Sys_GetProcUsage(pid, &usage);
+    TEST_RC(rc, P1_INVALID_PID);
+
+    rc = Sys_GetPid(&self);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_GetProcUsage(self, &before);
+    TEST_RC(rc, P1_SUCCESS);
+    for (int i = 0; i < 5; i++) {
+        rc = Sys_GetPid(&pid);
+        TEST_RC(rc, P1_SUCCESS);
+    }
+    rc = Sys_GetProcUsage(self, &after);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(after.syscalls, before.syscalls + 6);
+    TEST(after.sleepTime >= 10 * SLEEP * 1000, 1);
+    TEST(after.sectorsRead, 0);
+
+    // a batch is one system call, however many calls it makes
+    for (int i = 0; i < 3; i++) {
+        calls[i].number = SYS_GETPID;
+    }
+    rc = Sys_GetProcUsage(self, &before);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = Sys_Batch(calls, 3, FALSE, &done);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(done, 3);
+    rc = Sys_GetProcUsage(self, &after);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(after.syscalls, before.syscalls + 2);
+    TEST(after.kernelTime >= before.kernelTime, 1);
+    passed = TRUE;
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 2, &pid);
+    TEST_RC(rc, P1_SUCCESS);
+    rc = P2_Wait(&pid, &status);
+    TEST_RC(rc, P1_SUCCESS);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, UNIT, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED();
+    }
+}
+
+void finish(int argc, char **argv) {}
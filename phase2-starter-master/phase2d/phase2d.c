@@ -8,6 +8,7 @@
 #include <libdisk.h>
 
 #include "phase2Int.h"
+#include "phase2ext.h"
 
 static void     CreateStub(USLOSS_Sysargs *sysargs);
 
@@ -29,9 +30,18 @@ static void debug2(char *fmt, ...)
 
 int P2_Startup(void *arg)
 {
-    int rc, pid;
+    int rc, pid, status;
 
     // initialize clock and disk drivers
+    P2ClockInit();
+    P2DiskInit();
+    #ifdef DISK_WARM_START
+    // cache the disk, warmed with what was hot last time
+    rc = P2_DiskSetCacheBudget(P2_DISK_CACHE_TRACKS);
+    assert(rc == P1_SUCCESS);
+    rc = P2_DiskWarmStart(P2_DISK_MANIFEST);
+    assert(rc == P1_SUCCESS);
+    #endif
 
     debug2("starting\n");
     rc = P2_SetSyscallHandler(SYS_LOCKCREATE, CreateStub);
@@ -41,8 +51,12 @@ int P2_Startup(void *arg)
     assert(rc == P1_SUCCESS);
     
     // wait for P2_Spawn to terminate
+    rc = P2_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
 
     // shut down clock and disk drivers
+    P2DiskShutdown();
+    P2ClockShutdown();
 
     return 0;
 }
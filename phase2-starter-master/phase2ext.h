@@ -0,0 +1,339 @@
+/*
+ * Extensions to the Phase 2 interface. phase2.h is handed out and must not be modified, so the
+ * system calls, types and functions added on top of it are declared here.
+ *
+ */
+
+#ifndef _PHASE2_EXT_H
+#define _PHASE2_EXT_H
+
+#include <usloss.h>
+#include <usyscall.h>
+#include <phase1.h>
+
+#include "phase2.h"
+
+/*
+ * System calls added by Phase 2. USLOSS numbers its own calls below USLOSS_MAX_SYSCALLS,
+ * so these start after it. USLOSS_Syscall hands the number to the system call interrupt
+ * handler without checking it against USLOSS_MAX_SYSCALLS; SyscallHandler checks it
+ * against P2_MAX_SYSCALLS. The user-level stubs are in libuser2.h.
+ */
+
+#define SYS_P2_BASE             USLOSS_MAX_SYSCALLS
+#define SYS_DISKHEATMAP         (SYS_P2_BASE + 0)
+#define SYS_SLEEPMS             (SYS_P2_BASE + 1)
+#define SYS_SLEEPUNTIL          (SYS_P2_BASE + 2)
+#define SYS_TIMERCREATE         (SYS_P2_BASE + 3)
+#define SYS_TIMERWAIT           (SYS_P2_BASE + 4)
+#define SYS_TIMERDELETE         (SYS_P2_BASE + 5)
+#define SYS_DISKREADTIMED       (SYS_P2_BASE + 6)
+#define SYS_DISKWRITETIMED      (SYS_P2_BASE + 7)
+#define SYS_WAITTIMED           (SYS_P2_BASE + 8)
+#define SYS_CLOCKSTATS          (SYS_P2_BASE + 9)
+#define SYS_PROFILE             (SYS_P2_BASE + 10)
+#define SYS_TIMEPAGE            (SYS_P2_BASE + 11)
+#define SYS_SYSCALLSTATS        (SYS_P2_BASE + 12)
+#define SYS_BATCH               (SYS_P2_BASE + 13)
+#define SYS_TRACECONTROL        (SYS_P2_BASE + 14)
+#define SYS_TRACEREAD           (SYS_P2_BASE + 15)
+#define SYS_SPAWNMANY           (SYS_P2_BASE + 16)
+#define SYS_WAITN               (SYS_P2_BASE + 17)
+#define SYS_WAITPID             (SYS_P2_BASE + 18)
+#define SYS_WAITNOHANG          (SYS_P2_BASE + 19)
+#define SYS_GETPROCUSAGE        (SYS_P2_BASE + 20)
+#define SYS_GETPROCSNAPSHOT     (SYS_P2_BASE + 21)
+#define SYS_FUTEXWAIT           (SYS_P2_BASE + 22)
+#define SYS_FUTEXWAKE           (SYS_P2_BASE + 23)
+#define SYS_MAILBOXCREATE       (SYS_P2_BASE + 24)
+#define SYS_MAILBOXRELEASE      (SYS_P2_BASE + 25)
+#define SYS_MAILBOXSEND         (SYS_P2_BASE + 26)
+#define SYS_MAILBOXRECEIVE      (SYS_P2_BASE + 27)
+#define SYS_MAILBOXCONDSEND     (SYS_P2_BASE + 28)
+#define SYS_MAILBOXCONDRECEIVE  (SYS_P2_BASE + 29)
+#define SYS_WAITEVENTS          (SYS_P2_BASE + 30)
+#define SYS_DISKREADASYNC       (SYS_P2_BASE + 31)
+#define SYS_DISKWRITEASYNC      (SYS_P2_BASE + 32)
+#define SYS_DISKCOLLECT         (SYS_P2_BASE + 33)
+
+// size of the system call table, room for the numbers above and more
+#define P2_MAX_SYSCALLS         (SYS_P2_BASE + 48)
+
+// per system call counters, see P2_SyscallStats
+typedef struct P2_SyscallInfo {
+    int     calls;              // times the system call was made
+    int     errors;             // calls that returned a negative result in arg4
+    int     time;               // microseconds spent in the handler, including blocked time
+    int     maxTime;            // longest call
+} P2_SyscallInfo;
+
+// number of records kept by the system call tracer, older ones are overwritten
+#define P2_TRACE_RECORDS        256
+
+// one traced system call, see P2_TraceRead
+typedef struct P2_TraceRecord {
+    int     seq;                // calls traced before this one, gaps mean records were lost
+    int     pid;                // caller
+    int     number;             // system call number
+    int     args[3];            // arg1 to arg3 on entry
+    int     rc;                 // arg4 on exit
+    int     entry;              // time of entry, in microseconds
+    int     exit;               // time of exit
+} P2_TraceRecord;
+
+// one process to create, see P2_SpawnMany
+typedef struct P2_SpawnEntry {
+    char    *name;
+    int     (*func)(void *);
+    void    *arg;
+    int     stackSize;
+    int     priority;
+} P2_SpawnEntry;
+
+// resources used by a process, see P2_GetProcUsage. Times are in microseconds.
+typedef struct P2_ProcUsage {
+    int     kernelTime;         // time in system calls, less diskTime and sleepTime
+    int     userTime;           // the rest of the process's CPU time
+    int     syscalls;           // system calls made
+    int     sectorsRead;        // disk sectors read
+    int     sectorsWritten;     // disk sectors written
+    int     diskTime;           // time blocked on the disk
+    int     sleepTime;          // time asleep in P2_Sleep and friends
+} P2_ProcUsage;
+
+// one live process, see P2_GetProcSnapshot
+typedef struct P2_ProcSnapshot {
+    int         pid;
+    P1_ProcInfo info;
+} P2_ProcSnapshot;
+
+// P2_GetProcSnapshot filter that selects processes in the state, combine them with |
+#define P2_STATE(state)         (1 << (state))
+
+// number of mailboxes, and most slots a mailbox can have (see P2_MboxCreate)
+#define P2_MAX_MBOXES           32
+#define P2_MAX_SLOTS            64
+
+// a cap for P2_SpawnSetStackCap, requests up to this size are rounded up to a size class
+#define P2_STACK_CAP            (16 * USLOSS_MIN_STACK)
+
+// stack modes (see P2_SpawnSetStackMode)
+#define P2_STACK_FIXED          0   // stacks are the size asked for
+#define P2_STACK_MEASURE        1   // also record how much of it each process used
+#define P2_STACK_ADAPTIVE       2   // also size stacks from what earlier processes used
+
+// percentage added to the most stack used, when P2_STACK_ADAPTIVE sizes a stack
+#define P2_STACK_MARGIN         50
+
+// number of spawn names whose stack use is recorded
+#define P2_STACK_NAMES          32
+
+// stack use of the processes spawned with one name, see P2_SpawnStackStats
+typedef struct P2_StackStats {
+    char    name[P1_MAXNAME+1];
+    int     spawns;             // processes spawned with the name while measuring
+    int     measured;           // of those, processes whose function returned and was measured
+    int     stackSize;          // stack size given to the last one
+    int     maxUsed;            // most bytes any of them used
+} P2_StackStats;
+
+// maximum number of periodic timers (see P2_TimerCreate)
+#define P2_MAX_TIMERS           32
+
+/*
+ * Event types for P2_WaitEvents, and what the id of an event names.
+ */
+
+#define P2_EVENT_CHILD          0   // child exited, id is its pid or -1 for any child
+#define P2_EVENT_MBOX_RECV      1   // mailbox has a message, id is the mailbox
+#define P2_EVENT_MBOX_SEND      2   // mailbox has a free slot, id is the mailbox
+#define P2_EVENT_TIMER          3   // periodic timer expired, id is the timer
+#define P2_EVENT_DISK           4   // asynchronous disk request finished, id is its ticket
+#define P2_EVENT_TYPES          5
+
+// most events one P2_WaitEvents can wait for
+#define P2_MAX_EVENTS           16
+
+typedef struct P2_Event {
+    int     type;               // one of the P2_EVENT_ types
+    int     id;
+    int     ready;              // set by P2_WaitEvents
+} P2_Event;
+
+// buckets of the wakeup lateness histogram, the last one counts everything later
+#define P2_CLOCK_LATENESS       8
+
+typedef struct P2_ClockInfo {
+    int     ticks;              // clock interrupts handled
+    int     wakeups;            // sleepers and timers woken
+    int     lateness[P2_CLOCK_LATENESS]; // wakeups by ticks between due and actual wakeup
+    int     maxWoken;           // most wakeups in one interrupt
+    int     handlerTime;        // microseconds spent handling interrupts
+    int     maxHandlerTime;     // longest time spent handling one interrupt
+} P2_ClockInfo;
+
+// clock interrupts that found a process running, see P2_Profile
+typedef struct P2_ProfileSample {
+    int     kernel;             // samples taken while it was in kernel mode
+    int     user;               // samples taken while it was in user mode
+} P2_ProfileSample;
+
+// written by P2ClockShutdown if the profiler was turned on, one line per pid that was sampled
+#define P2_PROFILE_FILE         "clockprof.csv"
+
+/*
+ * Time page, updated by the clock driver on every clock interrupt. User code reads it directly
+ * (see Sys_GetTimeCoarse in libuser2.h) instead of trapping. seq is odd while the driver is
+ * updating the page; a reader retries if it saw an odd seq or seq changed during the read.
+ */
+typedef struct P2_TimePage {
+    volatile int    seq;
+    volatile int    now;        // time of the last clock interrupt, in microseconds
+    volatile int    ticks;      // clock interrupts so far
+} P2_TimePage;
+
+/*
+ * Disk scheduling policies (see P2_DiskSetPolicy).
+ */
+
+#define P2_DISK_FCFS            0
+#define P2_DISK_SSTF            1
+#define P2_DISK_LOOK            2
+#define P2_DISK_ADAPTIVE        3   // driver picks one of the above
+#define P2_DISK_POLICIES        3
+
+// default adaptive thresholds, depths in requests and seek distance in tracks
+#define P2_DISK_FCFS_DEPTH      2
+#define P2_DISK_LOOK_DEPTH      8
+#define P2_DISK_MIN_SEEK        1
+
+#define P2_DISK_MAX_EVENTS      8
+
+typedef struct P2_DiskPolicyEvent {
+    int     time;               // time of the change, in microseconds
+    int     from;               // previous policy
+    int     to;                 // new policy
+    int     avgDepth;           // averages that caused the change, scaled by 100
+    int     avgSeek;
+} P2_DiskPolicyEvent;
+
+typedef struct P2_DiskSchedInfo {
+    int     policy;             // policy currently in use
+    int     adaptive;           // TRUE if the driver picks the policy
+    int     avgDepth;           // moving average of queued requests, scaled by 100
+    int     avgSeek;            // moving average of tracks between head and request, scaled by 100
+    int     requests[P2_DISK_POLICIES]; // requests performed under each policy
+    int     sectors[P2_DISK_POLICIES];  // sectors transferred under each policy
+    int     seeks[P2_DISK_POLICIES];    // tracks moved under each policy
+    int     busy[P2_DISK_POLICIES];     // microseconds spent performing requests
+    int     switches;           // number of policy changes
+    int     cancelled;          // requests dropped because their process terminated
+    int     timeouts;           // requests withdrawn because their timeout expired
+    P2_DiskPolicyEvent events[P2_DISK_MAX_EVENTS]; // change i is in events[i % P2_DISK_MAX_EVENTS]
+} P2_DiskSchedInfo;
+
+// maximum number of tracks in the disk cache (see P2_DiskSetCacheBudget)
+#define P2_DISK_CACHE_TRACKS    32
+
+// hottest tracks, written by P2DiskShutdown for P2_DiskWarmStart
+#define P2_DISK_MANIFEST        "diskcache.manifest"
+
+typedef struct P2_DiskCacheInfo {
+    int     budget;             // tracks the cache may hold
+    int     used;               // tracks it holds
+    int     hits;               // reads served from the cache
+    int     misses;             // reads that went to the disk
+    int     prefetched;         // sectors read by warm-start prefetching
+} P2_DiskCacheInfo;
+
+// where tests write the heatmaps (see P2_DiskSetHeatmapFile)
+#define P2_DISK_HEATMAP         "diskheat.csv"
+
+// per-track access counts (see P2_DiskHeatmap)
+typedef struct P2_TrackHeat {
+    int     reads;              // sectors read from the track
+    int     writes;             // sectors written to the track
+    int     seeks;              // seeks that ended on the track
+} P2_TrackHeat;
+
+/* 
+ * Function prototypes for the extensions.
+ */
+
+extern  int     P2_SleepMs(int ms) CHECKRETURN;
+extern  int     P2_SleepUntil(int usec) CHECKRETURN;
+extern  int     P2_TimerCreate(int periodMs, int *timerId) CHECKRETURN;
+extern  int     P2_TimerWait(int timerId, int *expirations) CHECKRETURN;
+extern  int     P2_TimerDelete(int timerId) CHECKRETURN;
+extern  int     P2_WaitTimed(int timeoutMs, int *pid, int *status) CHECKRETURN;
+extern  int     P2_ClockStats(P2_ClockInfo *info) CHECKRETURN;
+extern  int     P2_ProfileSetRate(int every) CHECKRETURN;
+extern  int     P2_Profile(P2_ProfileSample *samples) CHECKRETURN;
+extern  const P2_TimePage *P2_TimePageGet(void);
+
+extern  int     P2_DiskTryRead(int unit, int first, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_DiskTryWrite(int unit, int first, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_DiskReadTimed(int unit, int first, int sectors, void *buffer, 
+                                 int timeoutMs) CHECKRETURN;
+extern  int     P2_DiskWriteTimed(int unit, int first, int sectors, void *buffer, 
+                                  int timeoutMs) CHECKRETURN;
+extern  int     P2_DiskSetQueueDepth(int unit, int limit) CHECKRETURN;
+extern  int     P2_DiskSetPolicy(int unit, int policy) CHECKRETURN;
+extern  int     P2_DiskSetThresholds(int unit, int fcfsDepth, int lookDepth, int minSeek) CHECKRETURN;
+extern  int     P2_DiskSchedStats(int unit, P2_DiskSchedInfo *info) CHECKRETURN;
+extern  int     P2_DiskHeatmap(int unit, P2_TrackHeat *heat, int *tracks) CHECKRETURN;
+extern  int     P2_DiskSetHeatmapFile(char *path) CHECKRETURN;
+extern  int     P2_DiskWarmStart(char *manifest) CHECKRETURN;
+extern  int     P2_DiskSetCacheBudget(int tracks) CHECKRETURN;
+extern  int     P2_DiskCacheStats(P2_DiskCacheInfo *info) CHECKRETURN;
+extern  int     P2_DiskReadAsync(int unit, int first, int sectors, void *buffer, 
+                                 int *ticket) CHECKRETURN;
+extern  int     P2_DiskWriteAsync(int unit, int first, int sectors, void *buffer, 
+                                  int *ticket) CHECKRETURN;
+extern  int     P2_DiskCollect(int ticket, int *status) CHECKRETURN;
+
+extern  int     P2_SpawnSetStackCap(int cap) CHECKRETURN;
+extern  int     P2_SpawnSetStackMode(int mode) CHECKRETURN;
+extern  int     P2_SpawnStackStats(P2_StackStats *stats, int max, int *count) CHECKRETURN;
+extern  int     P2_SpawnMany(P2_SpawnEntry *entries, int count, int *pids, int *spawned) CHECKRETURN;
+
+extern  int     P2_WaitN(int n, int *pids, int *statuses, int *count) CHECKRETURN;
+extern  int     P2_WaitPid(int pid, int *status) CHECKRETURN;
+extern  int     P2_WaitNoHang(int *pid, int *status) CHECKRETURN;
+extern  int     P2_GetProcUsage(int pid, P2_ProcUsage *usage) CHECKRETURN;
+extern  int     P2_GetProcSnapshot(P2_ProcSnapshot *buffer, int max, int states, 
+                                   int *count) CHECKRETURN;
+extern  int     P2_FutexWait(int *addr, int expected) CHECKRETURN;
+extern  int     P2_FutexWake(int *addr, int max, int *woken) CHECKRETURN;
+extern  int     P2_MboxCreate(int slots, int *mbox) CHECKRETURN;
+extern  int     P2_MboxRelease(int mbox) CHECKRETURN;
+extern  int     P2_MboxSend(int mbox, void *buffer, int size) CHECKRETURN;
+extern  int     P2_MboxReceive(int mbox, void **buffer, int *size) CHECKRETURN;
+extern  int     P2_MboxCondSend(int mbox, void *buffer, int size) CHECKRETURN;
+extern  int     P2_MboxCondReceive(int mbox, void **buffer, int *size) CHECKRETURN;
+extern  int     P2_WaitEvents(P2_Event *events, int count, int *ready) CHECKRETURN;
+
+extern  int     P2_SyscallStats(unsigned int number, P2_SyscallInfo *info) CHECKRETURN;
+extern  int     P2_Batch(USLOSS_Sysargs *calls, int count, int stopOnError, int *done) CHECKRETURN;
+extern  int     P2_TraceControl(int on) CHECKRETURN;
+extern  int     P2_TraceRead(P2_TraceRecord *records, int max, int *count) CHECKRETURN;
+
+/*
+ * Error codes of the extensions, following those in phase2.h
+ */
+
+#define P2_DISK_BUSY            -31
+#define P2_INVALID_ARGUMENT     -32
+#define P2_INVALID_TIMER        -33
+#define P2_TIMEOUT              -34
+#define P2_INVALID_MBOX         -35
+#define P2_WOULD_BLOCK          -36
+#define P2_MBOX_NOT_EMPTY       -37
+
+/*
+ * Default limit on outstanding requests per disk unit (see P2_DiskSetQueueDepth).
+ */
+
+#define P2_DISK_DEFAULT_DEPTH   P1_MAXPROC
+
+#endif
@@ -73,6 +73,9 @@ CFLAGS += -Wall -g -std=gnu99 -Werror -DPHASE=$(PHASE_UPPER) -D$(PHASE_UPPER) -D
 
 #CFLAGS += -DDEBUG
 
+# Uncomment to have phase2d cache the disk and warm the cache from the last run's manifest.
+#CFLAGS += -DDISK_WARM_START
+
 # You shouldn't need to change anything below here. 
 
 TARGET = lib$(PHASE)-$(VERSION).a
@@ -42,7 +42,14 @@ static char *errors[] = {
     "Invalid first sector.",
     "Invalid number of sectors.",
     "Address is NULL.",
-    "Process was not spawned."
+    "Process was not spawned.",
+    "Disk unit is busy.",
+    "Invalid argument.",
+    "Invalid timer.",
+    "Timed out.",
+    "Invalid mailbox.",
+    "Operation would block.",
+    "Mailbox is not empty."
 };
 
 static int numCodes = sizeof(errors) / sizeof(char *);
@@ -0,0 +1,134 @@
+/*
+ * User-level locks and condition variables. Acquiring a free lock and releasing one nobody waits
+ * for are a single atomic instruction each; only when processes contend do they trap, into
+ * Sys_FutexWait and Sys_FutexWake. Signaling a condition nobody waits on doesn't trap either.
+ * Locks and conditions must be in memory shared by the processes that use them, e.g. globals,
+ * and initialized before use.
+ */
+
+#ifndef _ULOCK_H
+#define _ULOCK_H
+
+#include "libuser2.h"
+
+// states of a ULock
+#define ULOCK_FREE      0
+#define ULOCK_HELD      1       // held, nobody waiting
+#define ULOCK_CONTENDED 2       // held, and there may be waiters
+
+typedef struct ULock {
+    int     state;
+} ULock;
+
+typedef struct UCond {
+    int     seq;                // bumped by every signal and broadcast
+    int     waiters;            // processes in UCond_Wait
+} UCond;
+
+/*
+ * ULock_Init
+ *
+ * Initializes the lock as free.
+ */
+static void
+ULock_Init(ULock *lock)
+{
+    lock->state = ULOCK_FREE;
+}
+
+/*
+ * ULock_Acquire
+ *
+ * Acquires the lock, blocking while another process holds it. A process that has to wait marks
+ * the lock contended so that the holder knows to wake it.
+ */
+static void
+ULock_Acquire(ULock *lock)
+{
+    int state = __sync_val_compare_and_swap(&lock->state, ULOCK_FREE, ULOCK_HELD);
+
+    while (state != ULOCK_FREE) {
+        if ((state == ULOCK_CONTENDED) ||
+            (__sync_val_compare_and_swap(&lock->state, ULOCK_HELD, ULOCK_CONTENDED)
+                != ULOCK_FREE)) {
+            (void) Sys_FutexWait(&lock->state, ULOCK_CONTENDED);
+        }
+        // there may be other waiters, so take it as contended
+        state = __sync_val_compare_and_swap(&lock->state, ULOCK_FREE, ULOCK_CONTENDED);
+    }
+}
+
+/*
+ * ULock_Release
+ *
+ * Releases the lock, waking a waiter if there may be one.
+ */
+static void
+ULock_Release(ULock *lock)
+{
+    if (__sync_fetch_and_sub(&lock->state, 1) != ULOCK_HELD) {
+        lock->state = ULOCK_FREE;
+        (void) Sys_FutexWake(&lock->state, 1, NULL);
+    }
+}
+
+/*
+ * UCond_Init
+ *
+ * Initializes the condition variable.
+ */
+static void
+UCond_Init(UCond *cond)
+{
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+/*
+ * UCond_Wait
+ *
+ * Releases the lock, waits for the condition to be signaled, and acquires the lock again. As
+ * with any condition variable, callers must check their condition again when this returns.
+ */
+static void
+UCond_Wait(UCond *cond, ULock *lock)
+{
+    // a signal after this changes seq, so the wait below won't miss it
+    int seq = cond->seq;
+
+    __sync_fetch_and_add(&cond->waiters, 1);
+    ULock_Release(lock);
+    (void) Sys_FutexWait(&cond->seq, seq);
+    __sync_fetch_and_sub(&cond->waiters, 1);
+    ULock_Acquire(lock);
+}
+
+/*
+ * UCond_Signal
+ *
+ * Wakes one process waiting on the condition, if there is one.
+ */
+static void
+UCond_Signal(UCond *cond)
+{
+    __sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters > 0) {
+        (void) Sys_FutexWake(&cond->seq, 1, NULL);
+    }
+}
+
+/*
+ * UCond_Broadcast
+ *
+ * Wakes all processes waiting on the condition.
+ */
+static void
+UCond_Broadcast(UCond *cond)
+{
+    __sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters > 0) {
+        (void) Sys_FutexWake(&cond->seq, P1_MAXPROC, NULL);
+    }
+}
+
+#endif